@@ -0,0 +1,248 @@
+// Copyright (C) 2020  Aleksey Romanov (aleksey at voltanet dot io)
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+// Throughput and latency of dynamic link churn
+//
+// Worker threads construct links at random levels, release and delete
+// them; every 8th link deletes itself from inside its init function.
+// Another thread loops Run()/Reset() for the whole time.
+//
+// For every thread count the ops/sec of construct-release-delete
+// cycles and p50/p99/p999 latencies of the constructor, the
+// Release(link) and the destructor are reported. Release(link) fails
+// while Run()/Reset() holds the run mutex, it is retried, the latency
+// of the successful call is reported along with the failure count.
+//
+#include <getopt.h>
+#include <init_chain.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>  // NOLINT
+#include <vector>
+
+bool simple::InitChain::AllowReset() { return true; }
+
+class BenchRunner : public simple::InitChain::Runner {
+ public:
+  bool Run() noexcept { return DoRun(); }
+  bool Reset() noexcept { return DoReset(); }
+  bool Release(simple::InitChain::Link* link) noexcept {
+    return DoRelease(link);
+  }
+};
+
+using Link = simple::InitChain::Link;
+using Clock = std::chrono::steady_clock;
+
+static bool Init() { return true; }
+static bool Reset() { return true; }
+
+// Link deleting itself from inside its init function
+class SelfDeletingLink final : public Link {
+ public:
+  explicit SelfDeletingLink(int level)
+      : Link(level, std::bind(&SelfDeletingLink::Init, this)) {}
+
+ private:
+  bool Init() {
+    delete this;
+    return true;
+  }
+};
+
+static int const kLevels = 10000;
+
+struct Latencies {
+  std::vector<uint64_t> construct;
+  std::vector<uint64_t> release;
+  std::vector<uint64_t> destruct;
+  uint64_t release_failures;
+};
+
+static uint64_t Since(Clock::time_point start) {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                           start)
+          .count());
+}
+
+static void Worker(unsigned seed, size_t ops, Latencies* lat) {
+  BenchRunner runner;
+  std::mt19937 rng(seed);
+
+  lat->construct.reserve(ops);
+  lat->release.reserve(ops);
+  lat->destruct.reserve(ops);
+  lat->release_failures = 0;
+
+  for (size_t i = 0; i < ops; i++) {
+    int level = static_cast<int>(rng() % kLevels);
+
+    if ((i & 0x7) == 0x7) {
+      // Owned by the chain from now on
+      new SelfDeletingLink(level);
+      continue;
+    }
+
+    auto start = Clock::now();
+    Link* link = new Link(level, Init, Reset);
+    lat->construct.push_back(Since(start));
+
+    for (;;) {
+      start = Clock::now();
+      bool res = runner.Release(link);
+      uint64_t elapsed = Since(start);
+      if (res) {
+        lat->release.push_back(elapsed);
+        break;
+      }
+      lat->release_failures++;
+      std::this_thread::yield();
+    }
+
+    start = Clock::now();
+    delete link;
+    lat->destruct.push_back(Since(start));
+  }
+}
+
+static void Driver(std::atomic<bool>* stop, size_t* cycles) {
+  BenchRunner runner;
+  while (!stop->load(std::memory_order_relaxed)) {
+    runner.Run();
+    runner.Reset();
+    (*cycles)++;
+  }
+}
+
+static uint64_t Percentile(std::vector<uint64_t> const& sorted, double p) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  size_t index = static_cast<size_t>(p * static_cast<double>(sorted.size()));
+  return sorted[std::min(index, sorted.size() - 1)];
+}
+
+static void Print(char const* name, std::vector<uint64_t>* lat) {
+  std::sort(lat->begin(), lat->end());
+  std::cout << std::setw(10) << name << std::setw(10) << Percentile(*lat, 0.5)
+            << std::setw(10) << Percentile(*lat, 0.99) << std::setw(10)
+            << Percentile(*lat, 0.999);
+}
+
+static void usage() {
+  std::cout << "usage: bench_churn [-n ops-per-thread] [-t max-threads]\n";
+}
+
+int main(int argc, char** argv) {
+  size_t ops = 2000;
+  size_t max_threads = 64;
+
+  for (;;) {
+    int c = getopt(argc, argv, "hn:t:");
+    if (c < 0) {
+      break;
+    }
+
+    switch (c) {
+      case 'n':
+        ops = strtoul(optarg, nullptr, 0);
+        break;
+      case 't':
+        max_threads = strtoul(optarg, nullptr, 0);
+        break;
+      case 'h':
+        usage();
+        return 0;
+      default:
+        usage();
+        return 1;
+    }
+  }
+
+  if (optind != argc || ops == 0 || max_threads == 0) {
+    usage();
+    return 1;
+  }
+
+  std::cout << "ops per thread: " << ops << ", latencies in ns\n";
+  std::cout << std::setw(8) << "threads" << std::setw(12) << "ops/sec"
+            << std::setw(10) << "runs" << std::setw(10) << "rel-fail";
+  for (char const* name : {"ctor", "release", "dtor"}) {
+    std::cout << std::setw(10) << name << std::setw(10) << "p50"
+              << std::setw(10) << "p99" << std::setw(10) << "p999";
+  }
+  std::cout << std::endl;
+
+  for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+    std::vector<Latencies> lat(threads);
+    std::vector<std::thread> workers;
+    std::atomic<bool> stop(false);
+    size_t cycles = 0;
+
+    std::thread driver(Driver, &stop, &cycles);
+
+    auto start = Clock::now();
+    for (size_t i = 0; i < threads; i++) {
+      workers.emplace_back(Worker, static_cast<unsigned>(i + 1), ops, &lat[i]);
+    }
+    for (auto& worker : workers) {
+      worker.join();
+    }
+    double seconds = static_cast<double>(Since(start)) / 1e9;
+
+    stop.store(true);
+    driver.join();
+
+    // Self deleting links left in the init list
+    BenchRunner().Run();
+
+    Latencies all;
+    all.release_failures = 0;
+    for (auto& item : lat) {
+      all.construct.insert(all.construct.end(), item.construct.begin(),
+                           item.construct.end());
+      all.release.insert(all.release.end(), item.release.begin(),
+                         item.release.end());
+      all.destruct.insert(all.destruct.end(), item.destruct.begin(),
+                          item.destruct.end());
+      all.release_failures += item.release_failures;
+    }
+
+    std::cout << std::setw(8) << threads << std::setw(12) << std::fixed
+              << std::setprecision(0)
+              << static_cast<double>(threads * ops) / seconds << std::setw(10)
+              << cycles << std::setw(10) << all.release_failures;
+    Print("", &all.construct);
+    Print("", &all.release);
+    Print("", &all.destruct);
+    std::cout << std::endl;
+  }
+
+  return 0;
+}
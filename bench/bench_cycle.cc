@@ -0,0 +1,178 @@
+// Copyright (C) 2020  Aleksey Romanov (aleksey at voltanet dot io)
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+// Repeated Reset()/Run() cycles, as test suites do before every
+// test case
+//
+// N links are constructed, run once, then reset and run again for
+// C cycles, ns per link for every phase. The schedule variant
+// takes the links from the snapshot of the first run, the lists
+// variant registers and deletes a link in every cycle, so the
+// snapshot is dropped and the lists are used.
+//
+// Levels are either unique or shared by 100 links each, the
+// links of a level are registered interleaved with others.
+//
+#include <getopt.h>
+#include <init_chain.h>
+
+#include <chrono>  // NOLINT
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+bool simple::InitChain::AllowReset() { return true; }
+
+class BenchRunner : public simple::InitChain::Runner {
+ public:
+  bool Run() noexcept { return DoRun(); }
+  bool Reset() noexcept { return DoReset(); }
+};
+
+using Link = simple::InitChain::Link;
+using Clock = std::chrono::steady_clock;
+
+static size_t counter;
+
+class Helper final : public Link {
+ public:
+  explicit Helper(int level)
+      : Link(level, [this]() { return Init(); }, [this]() { return Reset(); }),
+        value_() {}
+
+ private:
+  bool Init() {
+    value_++;
+    counter++;
+    return true;
+  }
+
+  bool Reset() {
+    value_--;
+    counter--;
+    return true;
+  }
+
+  size_t value_;
+};
+
+static double Since(Clock::time_point start) {
+  return static_cast<double>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                           start)
+          .count());
+}
+
+static void Cycle(char const* name, size_t count, size_t cycles,
+                  size_t same, bool invalidate) {
+  BenchRunner runner;
+  std::vector<Link*> links(count);
+  size_t levels = count > same ? count / same : 1;
+  for (size_t i = 0; i < count; i++) {
+    links[i] = new Helper(static_cast<int>(i % levels));
+  }
+
+  double n = static_cast<double>(count);
+  auto start = Clock::now();
+  runner.Run();
+  double first = Since(start) / n;
+
+  double run = 0;
+  double reset = 0;
+  for (size_t c = 0; c < cycles; c++) {
+    if (invalidate) {
+      delete new Helper(0);
+    }
+
+    start = Clock::now();
+    runner.Reset();
+    reset += Since(start);
+
+    start = Clock::now();
+    runner.Run();
+    run += Since(start);
+  }
+
+  n *= static_cast<double>(cycles);
+  runner.Reset();
+  for (size_t i = 0; i < count; i++) {
+    delete links[i];
+  }
+
+  if (counter != 0) abort();
+
+  std::cout << std::left << std::setw(10) << name << std::right
+            << std::setw(8) << same << std::fixed << std::setprecision(1)
+            << std::setw(12) << first << std::setw(12) << reset / n
+            << std::setw(12) << run / n << std::endl;
+}
+
+static void usage() {
+  std::cout << "usage: bench_cycle [-n count] [-c cycles]\n";
+}
+
+int main(int argc, char** argv) {
+  size_t count = 10000;
+  size_t cycles = 10000;
+
+  for (;;) {
+    int c = getopt(argc, argv, "c:hn:");
+    if (c < 0) {
+      break;
+    }
+
+    switch (c) {
+      case 'c':
+        cycles = strtoul(optarg, nullptr, 0);
+        break;
+      case 'n':
+        count = strtoul(optarg, nullptr, 0);
+        break;
+      case 'h':
+        usage();
+        return 0;
+      default:
+        usage();
+        return 1;
+    }
+  }
+
+  if (optind != argc || count == 0 || cycles == 0) {
+    usage();
+    return 1;
+  }
+
+  std::cout << "cycles: " << count << " links, " << cycles
+            << " cycles, ns per link\n";
+  std::cout << std::left << std::setw(10) << "variant" << std::right
+            << std::setw(8) << "same" << std::setw(12) << "first run"
+            << std::setw(12) << "reset" << std::setw(12) << "run"
+            << std::endl;
+
+  for (size_t same : {1, 100}) {
+    Cycle("schedule", count, cycles, same, false);
+    Cycle("lists", count, cycles, same, true);
+  }
+
+  return 0;
+}
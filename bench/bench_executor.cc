@@ -0,0 +1,369 @@
+// Copyright (C) 2020  Aleksey Romanov (aleksey at voltanet dot io)
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+// Executors of parallel levels
+//
+// Runs a chain of 8 levels with N links each, every level in
+// parallel, with:
+//
+//  inline    - InlineExecutor, links run on the calling thread
+//  fixed     - fixed pool, one queue under a mutex
+//  stealing  - work-stealing pool, a queue per thread, idle threads
+//              steal from the others
+//
+// for pools of 1 to 8 threads, with the links either computing
+// (cpu) or waiting (io) for the given number of microseconds.
+// Milliseconds per run are reported.
+//
+#include <getopt.h>
+#include <init_chain_tagged.h>
+
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <condition_variable>  // NOLINT
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>   // NOLINT
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+// Fixed pool: one queue
+class FixedPool {
+ public:
+  FixedPool() : stop_(false) {}
+
+  ~FixedPool() { Stop(); }
+
+  void Start(size_t threads) {
+    Stop();
+    stop_ = false;
+    for (size_t i = 0; i < threads; i++) {
+      threads_.emplace_back([this] { Loop(); });
+    }
+  }
+
+  void Stop() {
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      stop_ = true;
+    }
+    ready_.notify_all();
+    for (auto& thread : threads_) {
+      thread.join();
+    }
+    threads_.clear();
+  }
+
+  bool Submit(std::function<void()> task) noexcept {
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      tasks_.push_back(std::move(task));
+    }
+    ready_.notify_one();
+    return true;
+  }
+
+ private:
+  void Loop() {
+    for (;;) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        ready_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+        if (tasks_.empty()) {
+          return;
+        }
+        task = std::move(tasks_.front());
+        tasks_.pop_front();
+      }
+      task();
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable ready_;
+  std::deque<std::function<void()>> tasks_;
+  std::vector<std::thread> threads_;
+  bool stop_;
+};
+
+// Work-stealing pool: a queue per thread, submissions are spread
+// round robin, owners pop the front, thieves take the back
+class StealingPool {
+ public:
+  StealingPool() : next_(0), pending_(0), stop_(false) {}
+
+  ~StealingPool() { Stop(); }
+
+  void Start(size_t threads) {
+    Stop();
+    stop_ = false;
+    queues_.clear();
+    for (size_t i = 0; i < threads; i++) {
+      queues_.emplace_back(new Queue);
+    }
+    for (size_t i = 0; i < threads; i++) {
+      threads_.emplace_back([this, i] { Loop(i); });
+    }
+  }
+
+  void Stop() {
+    {
+      std::lock_guard<std::mutex> guard(idle_mutex_);
+      stop_ = true;
+    }
+    idle_.notify_all();
+    for (auto& thread : threads_) {
+      thread.join();
+    }
+    threads_.clear();
+  }
+
+  bool Submit(std::function<void()> task) noexcept {
+    Queue& queue = *queues_[next_++ % queues_.size()];
+    {
+      std::lock_guard<std::mutex> guard(queue.mutex);
+      queue.tasks.push_back(std::move(task));
+    }
+    {
+      std::lock_guard<std::mutex> guard(idle_mutex_);
+      pending_++;
+    }
+    idle_.notify_one();
+    return true;
+  }
+
+ private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  bool Take(size_t self, std::function<void()>* task) {
+    size_t count = queues_.size();
+    for (size_t i = 0; i < count; i++) {
+      Queue& queue = *queues_[(self + i) % count];
+      std::lock_guard<std::mutex> guard(queue.mutex);
+      if (queue.tasks.empty()) {
+        continue;
+      }
+      if (i == 0) {
+        *task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+      } else {
+        *task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+      }
+      return true;
+    }
+    return false;
+  }
+
+  void Loop(size_t self) {
+    for (;;) {
+      {
+        std::unique_lock<std::mutex> lock(idle_mutex_);
+        idle_.wait(lock, [this] { return stop_ || pending_ != 0; });
+        if (pending_ == 0) {
+          return;
+        }
+        pending_--;
+      }
+
+      std::function<void()> task;
+      while (!Take(self, &task)) {
+        std::this_thread::yield();
+      }
+      task();
+    }
+  }
+
+  std::vector<std::unique_ptr<Queue>> queues_;
+  std::vector<std::thread> threads_;
+  std::atomic<size_t> next_;
+  std::mutex idle_mutex_;
+  std::condition_variable idle_;
+  size_t pending_;
+  bool stop_;
+};
+
+struct InlineTag {};
+struct FixedTag {};
+struct StealingTag {};
+
+using InlineChain = simple::InitChain<InlineTag>;
+using FixedChain =
+    simple::InitChain<FixedTag, std::mutex, std::mutex, FixedPool>;
+using StealingChain =
+    simple::InitChain<StealingTag, std::mutex, std::mutex, StealingPool>;
+
+template <>
+bool InlineChain::AllowReset() {
+  return true;
+}
+
+template <>
+bool FixedChain::AllowReset() {
+  return true;
+}
+
+template <>
+bool StealingChain::AllowReset() {
+  return true;
+}
+
+template <typename CHAIN>
+class BenchRunner : public CHAIN::Runner {
+ public:
+  bool Run() noexcept { return this->DoRun(); }
+  bool Reset() noexcept { return this->DoReset(); }
+  void SetParallel(unsigned threads) noexcept { this->DoSetParallel(threads); }
+  void SetExecutor(typename CHAIN::Executor* executor) noexcept {
+    this->DoSetExecutor(executor);
+  }
+};
+
+static int const kLevels = 8;
+static int const kRounds = 5;
+
+static std::atomic<uint64_t> sink;
+
+// Computes or waits for the time
+static bool Work(bool io, std::chrono::microseconds time) {
+  if (io) {
+    std::this_thread::sleep_for(time);
+    return true;
+  }
+
+  auto end = Clock::now() + time;
+  uint64_t val = 0;
+  while (Clock::now() < end) {
+    for (int i = 0; i < 100; i++) {
+      val = val * 6364136223846793005ULL + 1;
+    }
+  }
+  sink += val;
+  return true;
+}
+
+// Returns: milliseconds per run
+template <typename CHAIN>
+static double Measure(typename CHAIN::Executor* executor, size_t threads,
+                      size_t links, bool io, std::chrono::microseconds time) {
+  BenchRunner<CHAIN> runner;
+  runner.SetExecutor(executor);
+  runner.SetParallel(static_cast<unsigned>(threads + 1));
+
+  std::vector<std::unique_ptr<typename CHAIN::Link>> chain;
+  for (int level = 0; level < kLevels; level++) {
+    for (size_t i = 0; i < links; i++) {
+      chain.emplace_back(new typename CHAIN::Link(
+          level, [io, time] { return Work(io, time); }, [] { return true; }));
+    }
+  }
+
+  double total = 0;
+  for (int round = 0; round < kRounds; round++) {
+    auto start = Clock::now();
+    runner.Run();
+    total += static_cast<double>(
+        std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() -
+                                                              start)
+            .count());
+    runner.Reset();
+  }
+  return total / kRounds / 1e3;
+}
+
+static void usage() {
+  std::cout << "usage: bench_executor [-n links] [-t usec]\n";
+}
+
+int main(int argc, char** argv) {
+  size_t links = 32;
+  int64_t usec = 200;
+
+  for (;;) {
+    int c = getopt(argc, argv, "hn:t:");
+    if (c < 0) {
+      break;
+    }
+
+    switch (c) {
+      case 'n':
+        links = strtoul(optarg, nullptr, 0);
+        break;
+      case 't':
+        usec = strtoll(optarg, nullptr, 0);
+        break;
+      case 'h':
+        usage();
+        return 0;
+      default:
+        usage();
+        return 1;
+    }
+  }
+
+  if (optind != argc || links == 0 || usec <= 0) {
+    usage();
+    return 1;
+  }
+
+  std::chrono::microseconds time(usec);
+  std::cout << "chain: " << kLevels << " levels of " << links << " links, "
+            << usec << " us per link, ms per run\n";
+  std::cout << std::setw(8) << "threads" << std::setw(6) << "work"
+            << std::setw(12) << "inline" << std::setw(12) << "fixed"
+            << std::setw(12) << "stealing" << std::endl;
+
+  InlineChain::Executor inline_executor;
+  FixedPool fixed;
+  StealingPool stealing;
+
+  for (size_t threads = 1; threads <= 8; threads *= 2) {
+    fixed.Start(threads);
+    stealing.Start(threads);
+
+    for (bool io : {false, true}) {
+      double inline_ms =
+          Measure<InlineChain>(&inline_executor, threads, links, io, time);
+      double fixed_ms = Measure<FixedChain>(&fixed, threads, links, io, time);
+      double stealing_ms =
+          Measure<StealingChain>(&stealing, threads, links, io, time);
+      std::cout << std::setw(8) << threads << std::setw(6)
+                << (io ? "io" : "cpu") << std::fixed << std::setprecision(2)
+                << std::setw(12) << inline_ms << std::setw(12) << fixed_ms
+                << std::setw(12) << stealing_ms << std::endl;
+    }
+  }
+
+  return 0;
+}
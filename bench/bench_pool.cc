@@ -0,0 +1,236 @@
+// Copyright (C) 2020  Aleksey Romanov (aleksey at voltanet dot io)
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+// Pooled links vs. links allocated by plain new/delete
+//
+// chain     - N links at random levels are constructed, run, reset
+//             and deleted, ns per link for every phase
+// allocator - 1 to 8 threads allocate and free link sized blocks
+//             in batches, million blocks per second
+//
+#include <getopt.h>
+#include <init_chain.h>
+
+#include <chrono>  // NOLINT
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>  // NOLINT
+#include <vector>
+
+bool simple::InitChain::AllowReset() { return true; }
+
+class BenchRunner : public simple::InitChain::Runner {
+ public:
+  bool Run() noexcept { return DoRun(); }
+  bool Reset() noexcept { return DoReset(); }
+};
+
+using Link = simple::InitChain::Link;
+using PooledLink = simple::InitChain::PooledLink;
+using Pool = simple::InitChain::Pool;
+using Clock = std::chrono::steady_clock;
+
+static size_t counter;
+
+// Same link with and without the pool
+template <typename BASE>
+class Helper final : public BASE {
+ public:
+  explicit Helper(int level)
+      : BASE(level, [this]() { return Init(); }, [this]() { return Reset(); }),
+        value_() {}
+
+ private:
+  bool Init() {
+    value_++;
+    counter++;
+    return true;
+  }
+
+  bool Reset() {
+    value_--;
+    counter--;
+    return true;
+  }
+
+  size_t value_;
+};
+
+static Link* MakePlain(int level) { return new Helper<Link>(level); }
+
+static Link* MakePooled(int level) {
+  return new (level) Helper<PooledLink>(level);
+}
+
+static int const kLevels = 10000;
+
+static double Since(Clock::time_point start) {
+  return static_cast<double>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                           start)
+          .count());
+}
+
+static void Chain(char const* name, size_t count,
+                  std::vector<int> const& levels, Link* (*make)(int)) {
+  BenchRunner runner;
+  std::vector<Link*> links(count);
+  double n = static_cast<double>(count);
+
+  auto start = Clock::now();
+  for (size_t i = 0; i < count; i++) {
+    links[i] = make(levels[i]);
+  }
+  double construct = Since(start) / n;
+
+  start = Clock::now();
+  runner.Run();
+  double run = Since(start) / n;
+
+  start = Clock::now();
+  runner.Reset();
+  double reset = Since(start) / n;
+
+  start = Clock::now();
+  for (size_t i = 0; i < count; i++) {
+    delete links[i];
+  }
+  double destruct = Since(start) / n;
+
+  if (counter != 0) abort();
+
+  std::cout << std::left << std::setw(10) << name << std::right << std::fixed
+            << std::setprecision(1) << std::setw(12) << construct
+            << std::setw(12) << run << std::setw(12) << reset << std::setw(12)
+            << destruct << std::endl;
+}
+
+static size_t const kBatch = 64;
+
+static void PlainWorker(size_t rounds, size_t size) {
+  void* blocks[kBatch];
+  for (size_t r = 0; r < rounds; r++) {
+    for (auto& block : blocks) {
+      block = ::operator new(size);
+    }
+    for (auto& block : blocks) {
+      ::operator delete(block);
+    }
+  }
+}
+
+static void PooledWorker(size_t rounds, size_t size, int level) {
+  void* blocks[kBatch];
+  for (size_t r = 0; r < rounds; r++) {
+    for (auto& block : blocks) {
+      block = Pool::Allocate(size, level);
+    }
+    for (auto& block : blocks) {
+      Pool::Free(block);
+    }
+  }
+}
+
+template <typename WORKER>
+static double Allocator(size_t threads, size_t rounds, WORKER worker) {
+  std::vector<std::thread> workers;
+  auto start = Clock::now();
+  for (size_t i = 0; i < threads; i++) {
+    workers.emplace_back([=]() { worker(i); });
+  }
+  for (auto& item : workers) {
+    item.join();
+  }
+  double ops = static_cast<double>(threads * rounds * kBatch);
+  return ops * 1e3 / Since(start);
+}
+
+static void usage() { std::cout << "usage: bench_pool [-n count]\n"; }
+
+int main(int argc, char** argv) {
+  size_t count = 100000;
+
+  for (;;) {
+    int c = getopt(argc, argv, "hn:");
+    if (c < 0) {
+      break;
+    }
+
+    switch (c) {
+      case 'n':
+        count = strtoul(optarg, nullptr, 0);
+        break;
+      case 'h':
+        usage();
+        return 0;
+      default:
+        usage();
+        return 1;
+    }
+  }
+
+  if (optind != argc || count == 0) {
+    usage();
+    return 1;
+  }
+
+  // Mostly ascending levels, as static objects of modules
+  std::mt19937 rng(1);
+  std::vector<int> levels(count);
+  for (size_t i = 0; i < count; i++) {
+    levels[i] = static_cast<int>((i * kLevels / count) + rng() % 16);
+  }
+
+  std::cout << "chain: " << count << " links, ns per link\n";
+  std::cout << std::left << std::setw(10) << "variant" << std::right
+            << std::setw(12) << "construct" << std::setw(12) << "run"
+            << std::setw(12) << "reset" << std::setw(12) << "delete"
+            << std::endl;
+
+  for (int i = 0; i < 2; i++) {
+    Chain("plain", count, levels, MakePlain);
+    Chain("pooled", count, levels, MakePooled);
+  }
+
+  size_t size = sizeof(Helper<PooledLink>);
+  size_t rounds = count / kBatch + 1;
+
+  std::cout << "\nallocator: " << size << " byte blocks, "
+            << "million blocks per second\n";
+  std::cout << std::setw(8) << "threads" << std::setw(12) << "plain"
+            << std::setw(12) << "pooled" << std::endl;
+
+  for (size_t threads = 1; threads <= 8; threads *= 2) {
+    double plain = Allocator(threads, rounds,
+                             [=](size_t) { PlainWorker(rounds, size); });
+    double pooled = Allocator(threads, rounds, [=](size_t i) {
+      PooledWorker(rounds, size, static_cast<int>(i * 100));
+    });
+    std::cout << std::setw(8) << threads << std::fixed << std::setprecision(1)
+              << std::setw(12) << plain << std::setw(12) << pooled
+              << std::endl;
+  }
+
+  return 0;
+}
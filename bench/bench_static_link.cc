@@ -0,0 +1,196 @@
+// Copyright (C) 2020  Aleksey Romanov (aleksey at voltanet dot io)
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+// Startup cost of static links vs. dynamic links
+//
+// Constructs N links, runs the chain and deletes the links, for:
+//
+//  dynamic-random    - Link with std::function, random levels
+//  dynamic-ascending - Link with std::function, ascending levels
+//  static-ascending  - StaticLink, ascending levels
+//
+// Ascending levels is the common case for static objects of a
+// module; random levels show the cost of the insertion walk.
+//
+#include <getopt.h>
+#include <init_chain.h>
+
+#include <chrono>  // NOLINT
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+bool simple::InitChain::AllowReset() { return true; }
+
+class BenchRunner : public simple::InitChain::Runner {
+ public:
+  bool Run() noexcept { return DoRun(); }
+  bool Reset() noexcept { return DoReset(); }
+};
+
+using Link = simple::InitChain::Link;
+using Clock = std::chrono::steady_clock;
+
+static size_t counter;
+
+static bool Init() {
+  counter++;
+  return true;
+}
+
+static bool Reset() {
+  counter--;
+  return true;
+}
+
+static int const kLevels = 64;
+
+template <int LEVEL>
+struct Maker {
+  static Link* Make() {
+    return new simple::InitChain::StaticLink<LEVEL, &Init, &Reset>();
+  }
+
+  static void Fill(Link* (**table)()) {
+    table[LEVEL] = &Make;
+    Maker<LEVEL - 1>::Fill(table);
+  }
+};
+
+template <>
+struct Maker<-1> {
+  static void Fill(Link* (**)()) {}
+};
+
+struct Result {
+  double construct_ns;
+  double run_ns;
+  double reset_ns;
+  double delete_ns;
+};
+
+static double PerLink(Clock::time_point start, size_t count) {
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                                 start);
+  return static_cast<double>(ns.count()) / static_cast<double>(count);
+}
+
+template <typename MAKE>
+static Result Measure(size_t count, MAKE make) {
+  BenchRunner runner;
+  std::vector<Link*> links(count);
+  Result result;
+
+  auto start = Clock::now();
+  for (size_t i = 0; i < count; i++) {
+    links[i] = make(i);
+  }
+  result.construct_ns = PerLink(start, count);
+
+  start = Clock::now();
+  runner.Run();
+  result.run_ns = PerLink(start, count);
+
+  start = Clock::now();
+  runner.Reset();
+  result.reset_ns = PerLink(start, count);
+
+  start = Clock::now();
+  for (size_t i = 0; i < count; i++) {
+    delete links[i];
+  }
+  result.delete_ns = PerLink(start, count);
+
+  if (counter != 0) abort();
+  return result;
+}
+
+static void Print(char const* name, Result const& result) {
+  std::cout << std::left << std::setw(20) << name << std::right << std::fixed
+            << std::setprecision(1) << std::setw(12) << result.construct_ns
+            << std::setw(12) << result.run_ns << std::setw(12)
+            << result.reset_ns << std::setw(12) << result.delete_ns
+            << std::endl;
+}
+
+static void usage() {
+  std::cout << "usage: bench_static_link [-n count]\n";
+}
+
+int main(int argc, char** argv) {
+  size_t count = 10000;
+
+  for (;;) {
+    int c = getopt(argc, argv, "hn:");
+    if (c < 0) {
+      break;
+    }
+
+    switch (c) {
+      case 'n':
+        count = strtoul(optarg, nullptr, 0);
+        break;
+      case 'h':
+        usage();
+        return 0;
+      default:
+        usage();
+        return 1;
+    }
+  }
+
+  if (optind != argc || count == 0) {
+    usage();
+    return 1;
+  }
+
+  Link* (*makers[kLevels])();
+  Maker<kLevels - 1>::Fill(makers);
+
+  std::mt19937 rng(1);
+  std::vector<int> random_levels(count);
+  for (size_t i = 0; i < count; i++) {
+    random_levels[i] = static_cast<int>(rng() % kLevels);
+  }
+
+  std::cout << "links: " << count << ", ns per link\n";
+  std::cout << std::left << std::setw(20) << "variant" << std::right
+            << std::setw(12) << "construct" << std::setw(12) << "run"
+            << std::setw(12) << "reset" << std::setw(12) << "delete"
+            << std::endl;
+
+  Print("dynamic-random", Measure(count, [&](size_t i) {
+          return new Link(random_levels[i], Init, Reset);
+        }));
+
+  Print("dynamic-ascending", Measure(count, [&](size_t i) {
+          return new Link(static_cast<int>(i * kLevels / count), Init, Reset);
+        }));
+
+  Print("static-ascending", Measure(count, [&](size_t i) {
+          return makers[i * kLevels / count]();
+        }));
+
+  return 0;
+}
@@ -23,8 +23,34 @@
 #ifndef INIT_CHAIN_H_
 #define INIT_CHAIN_H_
 
+#if defined(__linux__)
+#include <pthread.h>
+#include <sys/resource.h>
+#endif
+
+#ifdef INIT_CHAIN_USDT
+#include <sys/sdt.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT we need the standard chrono
+#include <climits>
+#include <condition_variable>  // NOLINT we need the standard condition variable
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <exception>
 #include <functional>
+#include <memory>
 #include <mutex>  // NOLINT we need the standard mutex
+#include <new>
+#include <thread>  // NOLINT we need the standard thread
+#include <utility>
+#include <vector>
+
+#include "init_chain_executor.h"
+#include "init_chain_histogram.h"
 
 #if __cplusplus < 201103L
 #error "At least c++11 is required"
@@ -41,14 +67,20 @@
 
 namespace simple {
 
-// We have to provide typdefs for mutexes Note: these typedefs
-// are completely encapsulated inside the InitChain class
+// We have to provide typdefs for mutexes and the executor of
+// parallel levels Note: these typedefs are completely encapsulated
+// inside the InitChain class
 
 #define RUN_MUTEX_TYPEDEF using RUN_MUTEX = std::mutex;
 #define LINK_MUTEX_TYPEDEF using LINK_MUTEX = std::mutex;
+#define EXECUTOR_TYPEDEF using EXECUTOR = simple::ThreadExecutor;
 
 #include "init_chain.inc"
 
+#ifdef INIT_CHAIN_CONSTINIT
+constinit inline InitChain::Bucket InitChain::chain_bucket_{};
+#endif
+
 }  // namespace simple
 
 #endif  // INIT_CHAIN_H_
@@ -0,0 +1,597 @@
+// Copyright (C) 2020  Aleksey Romanov (aleksey at voltanet dot io)
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef INIT_CHAIN_ANALYZER_H_
+#define INIT_CHAIN_ANALYZER_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <istream>
+#include <map>
+#include <ostream>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if __cplusplus < 201103L
+#error "At least c++11 is required"
+#endif
+
+// Offline analyzer of a recorded startup profile: how much could be
+// gained by running init functions in parallel.
+//
+// The profile is a list of links with their levels, durations (any unit)
+// and optional declared dependencies, the text form is one link per line:
+//
+//   # name level duration [dependency ...]
+//   logger   10  120
+//   config   20  800
+//   db      100 5000 config
+//   cache   100 3000 config logger
+//
+// Two models are supported:
+//
+//   level barriers (default) - the chain order: a link starts after all
+//       links of lower levels are done, links of the same level are
+//       independent unless there are declared dependencies, which must
+//       not point to higher levels.
+//
+//   dependencies only - a link starts after its declared dependencies
+//       are done, levels are ignored. This is the best case if all
+//       real dependencies are declared.
+//
+// The analyzer computes the critical path, the makespan for K threads
+// (list scheduling by the longest remaining path, and the lower bound),
+// idle time per level for K threads and the links to optimize first.
+// The graph could be written in DOT and JSON formats.
+//
+// See README.md and tools/init_chain_analyze.cc
+//
+
+namespace simple {
+
+class StartupAnalyzer final {
+ public:
+  struct Entry {
+    std::string name;
+    int level;
+    double duration;
+    std::vector<std::string> deps;
+  };
+
+  // Per-level summary of a K-thread schedule
+  struct LevelGap {
+    int level;
+    double start;     // First link of the level started
+    double finish;    // Last link of the level finished
+    double busy;      // Sum of durations
+    double idle;      // threads * (finish - start) - busy
+  };
+
+  StartupAnalyzer() noexcept : level_barriers_(true), analyzed_() {}
+
+  // Use the chain model (default) or dependencies only
+  void SetLevelBarriers(bool val) noexcept {
+    level_barriers_ = val;
+    analyzed_ = false;
+  }
+
+  void Add(Entry const& entry) {
+    entries_.push_back(entry);
+    analyzed_ = false;
+  }
+
+  // Reads the text form of the profile
+  //
+  // Returns: false and the line number in the error on bad lines
+  bool Load(std::istream& in, std::string* error) {
+    std::string line;
+    size_t line_no = 0;
+    while (std::getline(in, line)) {
+      line_no++;
+      size_t pos = line.find('#');
+      if (pos != std::string::npos) {
+        line.resize(pos);
+      }
+
+      std::istringstream fields(line);
+      Entry entry;
+      if (!(fields >> entry.name)) {
+        continue;  // Empty line
+      }
+
+      if (!(fields >> entry.level >> entry.duration) || entry.duration < 0) {
+        if (error) {
+          *error = "bad profile line " + std::to_string(line_no);
+        }
+        return false;
+      }
+
+      std::string dep;
+      while (fields >> dep) {
+        entry.deps.push_back(dep);
+      }
+      Add(entry);
+    }
+    return true;
+  }
+
+  // Builds the graph and computes the critical path
+  //
+  // Returns: false on duplicate names, unknown dependencies,
+  // dependencies on higher levels with level barriers or cycles
+  bool Analyze(std::string* error) {
+    analyzed_ = false;
+    std::map<std::string, size_t> index;
+    for (size_t i = 0; i < entries_.size(); i++) {
+      if (!index.insert(std::make_pair(entries_[i].name, i)).second) {
+        return Fail(error, "duplicate link " + entries_[i].name);
+      }
+    }
+
+    preds_.assign(entries_.size(), std::vector<size_t>());
+    for (size_t i = 0; i < entries_.size(); i++) {
+      for (auto const& dep : entries_[i].deps) {
+        auto it = index.find(dep);
+        if (it == index.end()) {
+          return Fail(error, "unknown dependency " + dep + " of " +
+                                 entries_[i].name);
+        }
+        if (level_barriers_ && entries_[it->second].level > entries_[i].level) {
+          return Fail(error, "dependency " + dep + " of " + entries_[i].name +
+                                 " is on a higher level");
+        }
+        preds_[i].push_back(it->second);
+      }
+    }
+
+    if (!Order(error)) {
+      return false;
+    }
+
+    // Earliest finish with unlimited threads, with level barriers
+    // order_ is sorted by level and a link starts after the link of
+    // lower levels finishing last
+    finish_.assign(entries_.size(), 0);
+    critical_pred_.assign(entries_.size(), kNone);
+    size_t barrier = kNone;       // Latest finish of lower levels
+    size_t level_latest = kNone;  // Latest finish of the current level
+    for (size_t pos = 0; pos < order_.size(); pos++) {
+      size_t i = order_[pos];
+      if (level_barriers_ && pos > 0 &&
+          entries_[order_[pos - 1]].level != entries_[i].level) {
+        barrier = level_latest;
+      }
+
+      double start = 0;
+      size_t pred = kNone;
+      if (level_barriers_ && barrier != kNone) {
+        pred = barrier;
+        start = finish_[pred];
+      }
+      for (size_t dep : preds_[i]) {
+        if (finish_[dep] > start) {
+          start = finish_[dep];
+          pred = dep;
+        }
+      }
+      finish_[i] = start + entries_[i].duration;
+      critical_pred_[i] = pred;
+      if (level_latest == kNone || finish_[i] > finish_[level_latest]) {
+        level_latest = i;
+      }
+    }
+
+    // Longest remaining path, used as the scheduling priority
+    tail_.assign(entries_.size(), 0);
+    std::vector<std::vector<size_t>> succs = Successors();
+    for (auto it = order_.rbegin(); it != order_.rend(); ++it) {
+      double longest = 0;
+      for (size_t succ : succs[*it]) {
+        longest = std::max(longest, tail_[succ]);
+      }
+      tail_[*it] = longest + entries_[*it].duration;
+    }
+
+    analyzed_ = true;
+    return true;
+  }
+
+  // Sum of durations, i.e. the single thread startup
+  double GetTotal() const noexcept {
+    double total = 0;
+    for (auto const& entry : entries_) {
+      total += entry.duration;
+    }
+    return total;
+  }
+
+  // Length of the critical path, the makespan with unlimited threads
+  double GetCriticalPathLength() const noexcept {
+    double length = 0;
+    for (double finish : finish_) {
+      length = std::max(length, finish);
+    }
+    return length;
+  }
+
+  // Names of the links on the critical path, in the order of execution
+  std::vector<std::string> GetCriticalPath() const {
+    std::vector<std::string> path;
+    if (!analyzed_ || entries_.empty()) {
+      return path;
+    }
+
+    size_t cur = static_cast<size_t>(
+        std::max_element(finish_.begin(), finish_.end()) - finish_.begin());
+    while (cur != kNone) {
+      path.push_back(entries_[cur].name);
+      cur = critical_pred_[cur];
+    }
+    std::reverse(path.begin(), path.end());
+    return path;
+  }
+
+  // Lower bound of the makespan with the number of threads
+  double GetMakespanBound(size_t threads) const noexcept {
+    if (threads == 0) {
+      return 0;
+    }
+    return std::max(GetCriticalPathLength(),
+                    GetTotal() / static_cast<double>(threads));
+  }
+
+  // Makespan of the list schedule with the number of threads, the
+  // ready link with the longest remaining path goes first
+  double GetMakespan(size_t threads) const {
+    std::vector<double> start;
+    std::vector<double> finish;
+    return Schedule(threads, &start, &finish);
+  }
+
+  // Idle time per level of the list schedule
+  std::vector<LevelGap> GetLevelGaps(size_t threads) const {
+    std::vector<double> start;
+    std::vector<double> finish;
+    Schedule(threads, &start, &finish);
+
+    std::map<int, LevelGap> levels;
+    for (size_t i = 0; i < entries_.size(); i++) {
+      int level = entries_[i].level;
+      auto res = levels.insert(std::make_pair(
+          level, LevelGap{level, start[i], finish[i], 0, 0}));
+      LevelGap& gap = res.first->second;
+      gap.start = std::min(gap.start, start[i]);
+      gap.finish = std::max(gap.finish, finish[i]);
+      gap.busy += entries_[i].duration;
+    }
+
+    std::vector<LevelGap> gaps;
+    for (auto& item : levels) {
+      LevelGap& gap = item.second;
+      gap.idle = static_cast<double>(threads) * (gap.finish - gap.start) -
+                 gap.busy;
+      gaps.push_back(gap);
+    }
+    return gaps;
+  }
+
+  // Links on the critical path, the longest first: shortening any of
+  // them shortens the best possible startup
+  std::vector<std::string> GetTopLinks(size_t count) const {
+    std::vector<std::string> path = GetCriticalPath();
+    std::map<std::string, double> durations;
+    for (auto const& entry : entries_) {
+      durations[entry.name] = entry.duration;
+    }
+    std::stable_sort(path.begin(), path.end(),
+                     [&](std::string const& a, std::string const& b) {
+                       return durations[a] > durations[b];
+                     });
+    if (path.size() > count) {
+      path.resize(count);
+    }
+    return path;
+  }
+
+  // Graph in DOT format, links are clustered by level,
+  // the critical path is red
+  void WriteDot(std::ostream& out) const {
+    std::vector<bool> critical = CriticalFlags();
+    std::map<int, std::vector<size_t>> levels;
+    for (size_t i = 0; i < entries_.size(); i++) {
+      levels[entries_[i].level].push_back(i);
+    }
+
+    out << "digraph startup {\n  rankdir=LR;\n  node [shape=box];\n";
+    for (auto const& level : levels) {
+      out << "  subgraph \"cluster_" << level.first << "\" {\n"
+          << "    label=\"level " << level.first << "\";\n";
+      for (size_t i : level.second) {
+        out << "    n" << i << " [label=\"" << Escape(entries_[i].name)
+            << "\\n" << entries_[i].duration << "\""
+            << (critical[i] ? " color=red" : "") << "];\n";
+      }
+      out << "  }\n";
+    }
+    for (size_t i = 0; i < entries_.size(); i++) {
+      for (size_t dep : preds_[i]) {
+        out << "  n" << dep << " -> n" << i << ";\n";
+      }
+      if (critical[i] && critical_pred_[i] != kNone &&
+          std::find(preds_[i].begin(), preds_[i].end(), critical_pred_[i]) ==
+              preds_[i].end()) {
+        // Level barrier on the critical path
+        out << "  n" << critical_pred_[i] << " -> n" << i
+            << " [style=dashed color=red];\n";
+      }
+    }
+    out << "}\n";
+  }
+
+  // Links, their schedule with unlimited threads and
+  // the critical path in JSON format
+  void WriteJson(std::ostream& out) const {
+    std::vector<bool> critical = CriticalFlags();
+    out << "{\n  \"level_barriers\": "
+        << (level_barriers_ ? "true" : "false") << ",\n  \"total\": "
+        << GetTotal() << ",\n  \"critical_path_length\": "
+        << GetCriticalPathLength() << ",\n  \"links\": [";
+    for (size_t i = 0; i < entries_.size(); i++) {
+      Entry const& entry = entries_[i];
+      out << (i ? ",\n" : "\n") << "    {\"name\": \"" << Escape(entry.name)
+          << "\", \"level\": " << entry.level
+          << ", \"duration\": " << entry.duration << ", \"deps\": [";
+      for (size_t j = 0; j < entry.deps.size(); j++) {
+        out << (j ? ", " : "") << "\"" << Escape(entry.deps[j]) << "\"";
+      }
+      out << "], \"start\": "
+          << (analyzed_ ? finish_[i] - entry.duration : 0)
+          << ", \"finish\": " << (analyzed_ ? finish_[i] : 0)
+          << ", \"critical\": " << (critical[i] ? "true" : "false") << "}";
+    }
+    out << "\n  ],\n  \"critical_path\": [";
+    std::vector<std::string> path = GetCriticalPath();
+    for (size_t i = 0; i < path.size(); i++) {
+      out << (i ? ", " : "") << "\"" << Escape(path[i]) << "\"";
+    }
+    out << "]\n}\n";
+  }
+
+ private:
+  enum : size_t { kNone = static_cast<size_t>(-1) };
+
+  static bool Fail(std::string* error, std::string const& msg) {
+    if (error) {
+      *error = msg;
+    }
+    return false;
+  }
+
+  static std::string Escape(std::string const& str) {
+    std::string res;
+    for (char c : str) {
+      if (c == '"' || c == '\\') {
+        res += '\\';
+      }
+      res += c;
+    }
+    return res;
+  }
+
+  // Topological order by dependencies, with level barriers
+  // lower levels go first
+  bool Order(std::string* error) {
+    std::vector<size_t> by_level(entries_.size());
+    for (size_t i = 0; i < by_level.size(); i++) {
+      by_level[i] = i;
+    }
+    std::stable_sort(by_level.begin(), by_level.end(),
+                     [this](size_t a, size_t b) {
+                       return entries_[a].level < entries_[b].level;
+                     });
+
+    std::vector<size_t> missing(entries_.size());
+    std::vector<std::vector<size_t>> succs = Successors();
+    for (size_t i = 0; i < entries_.size(); i++) {
+      missing[i] = preds_[i].size();
+    }
+
+    // Kahn's algorithm, the ready set is ordered by (level, position)
+    std::vector<size_t> rank(entries_.size());
+    for (size_t i = 0; i < by_level.size(); i++) {
+      rank[by_level[i]] = i;
+    }
+    auto later = [&rank](size_t a, size_t b) { return rank[a] > rank[b]; };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(later)> ready(
+        later);
+    for (size_t i = 0; i < entries_.size(); i++) {
+      if (missing[i] == 0) {
+        ready.push(i);
+      }
+    }
+
+    order_.clear();
+    while (!ready.empty()) {
+      size_t cur = ready.top();
+      ready.pop();
+      order_.push_back(cur);
+      for (size_t succ : succs[cur]) {
+        if (--missing[succ] == 0) {
+          ready.push(succ);
+        }
+      }
+    }
+
+    if (order_.size() != entries_.size()) {
+      return Fail(error, "dependency cycle");
+    }
+
+    if (level_barriers_) {
+      // Dependencies never point up, so ordering by level
+      // keeps the dependency order
+      std::stable_sort(order_.begin(), order_.end(),
+                       [this](size_t a, size_t b) {
+                         return entries_[a].level < entries_[b].level;
+                       });
+    }
+    return true;
+  }
+
+  std::vector<std::vector<size_t>> Successors() const {
+    std::vector<std::vector<size_t>> succs(entries_.size());
+    for (size_t i = 0; i < entries_.size(); i++) {
+      for (size_t dep : preds_[i]) {
+        succs[dep].push_back(i);
+      }
+    }
+    return succs;
+  }
+
+  // Schedules links on the threads, fills start and finish times
+  //
+  // Returns: makespan
+  double Schedule(size_t threads, std::vector<double>* start,
+                  std::vector<double>* finish) const {
+    size_t count = entries_.size();
+    start->assign(count, 0);
+    finish->assign(count, 0);
+    if (!analyzed_ || threads == 0 || count == 0) {
+      return 0;
+    }
+
+    std::vector<std::vector<size_t>> succs = Successors();
+    std::vector<size_t> missing(count);
+    for (size_t i = 0; i < count; i++) {
+      missing[i] = preds_[i].size();
+    }
+
+    // Links of a level become ready when all links of lower
+    // levels are done
+    std::map<int, size_t> level_left;
+    for (auto const& entry : entries_) {
+      level_left[entry.level]++;
+    }
+    auto level_it = level_left.begin();
+
+    auto lower = [this](size_t a, size_t b) {
+      return tail_[a] < tail_[b] || (tail_[a] == tail_[b] && a > b);
+    };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(lower)> ready(
+        lower);
+    std::vector<bool> released(count, !level_barriers_);
+
+    auto release = [&]() {
+      for (size_t i = 0; i < count; i++) {
+        if (!released[i] && (!level_barriers_ ||
+                             entries_[i].level == level_it->first)) {
+          if (level_barriers_) {
+            released[i] = true;
+          }
+          if (missing[i] == 0) {
+            ready.push(i);
+          }
+        }
+      }
+    };
+
+    if (level_barriers_) {
+      release();
+    } else {
+      for (size_t i = 0; i < count; i++) {
+        if (missing[i] == 0) {
+          ready.push(i);
+        }
+      }
+    }
+
+    // (finish time, link) of running links
+    typedef std::pair<double, size_t> Running;
+    std::priority_queue<Running, std::vector<Running>, std::greater<Running>>
+        running;
+    double now = 0;
+    size_t done = 0;
+
+    while (done < count) {
+      while (!ready.empty() && running.size() < threads) {
+        size_t cur = ready.top();
+        ready.pop();
+        (*start)[cur] = now;
+        (*finish)[cur] = now + entries_[cur].duration;
+        running.push(Running((*finish)[cur], cur));
+      }
+
+      if (running.empty()) {
+        break;  // Can not happen after a successful Analyze()
+      }
+
+      Running item = running.top();
+      running.pop();
+      now = item.first;
+      done++;
+
+      size_t cur = item.second;
+      for (size_t succ : succs[cur]) {
+        if (--missing[succ] == 0 && released[succ]) {
+          ready.push(succ);
+        }
+      }
+
+      if (level_barriers_ && --level_it->second == 0) {
+        ++level_it;
+        if (level_it != level_left.end()) {
+          release();
+        }
+      }
+    }
+
+    return now;
+  }
+
+  std::vector<bool> CriticalFlags() const {
+    std::vector<bool> critical(entries_.size(), false);
+    std::map<std::string, size_t> index;
+    for (size_t i = 0; i < entries_.size(); i++) {
+      index[entries_[i].name] = i;
+    }
+    for (auto const& name : GetCriticalPath()) {
+      critical[index[name]] = true;
+    }
+    return critical;
+  }
+
+  bool level_barriers_;
+  bool analyzed_;
+  std::vector<Entry> entries_;
+  std::vector<std::vector<size_t>> preds_;  // Declared dependencies
+  std::vector<size_t> order_;               // Topological order
+  std::vector<double> finish_;              // Unlimited threads
+  std::vector<size_t> critical_pred_;       // Predecessor defining start
+  std::vector<double> tail_;                // Longest remaining path
+};
+
+}  // namespace simple
+
+#endif  // INIT_CHAIN_ANALYZER_H_
@@ -0,0 +1,540 @@
+// Copyright (C) 2020  Aleksey Romanov (aleksey at voltanet dot io)
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef INIT_CHAIN_CACHE_H_
+#define INIT_CHAIN_CACHE_H_
+
+#include <fcntl.h>
+#include <link.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>  // NOLINT we need the standard mutex
+#include <string>
+#include <utility>
+#include <vector>
+
+#if __cplusplus < 201103L
+#error "At least c++11 is required"
+#endif
+
+// Warm start cache for expensive init results (POSIX)
+//
+// Init functions computing large derived tables from rarely changing
+// inputs could keep the serialized result in a memory-mapped cache
+// file, on the next start the link gets the prebuilt bytes straight
+// from the mapping instead of running the expensive path:
+//
+//   simple::WarmCache cache("/var/cache/app/init.cache",
+//                           simple::WarmCache::GetBinaryId());
+//   cache.Open();
+//
+//   simple::WarmStartLink<simple::InitChain> rules_link(
+//       50, &cache, "rules",
+//       [] { return RulesInputChecksum(); },
+//       [](void const* data, size_t size) { return Rules::Map(data, size); },
+//       [](std::vector<char>* out) { return Rules::Compile(out); });
+//
+//   runner.Run();
+//   cache.Commit();
+//
+// An entry is valid if its key, the cache build id and the input
+// checksum match. Commit() writes a new file and renames it over
+// the old one, so readers never see a partial file.
+//
+// See README.md and comments in init_chain.inc for details
+//
+
+namespace simple {
+
+class WarmCache final {
+ public:
+  WarmCache(std::string const& path, std::string const& build_id)
+      : path_(path),
+        build_id_(Checksum(build_id.data(), build_id.size())),
+        map_(),
+        map_size_(),
+        hits_(),
+        misses_() {}
+
+  WarmCache(WarmCache const& other) = delete;
+  WarmCache(WarmCache&& other) = delete;
+  WarmCache& operator=(WarmCache const& other) = delete;
+  WarmCache& operator=(WarmCache&& other) = delete;
+
+  // Bytes handed out by Lookup() and Store() stay valid until
+  // the cache is destroyed: a mapping replaced by Open() and bytes
+  // replaced by Store() are kept until then
+  ~WarmCache() {
+    Unmap();
+    for (auto const& map : retired_maps_) {
+      munmap(const_cast<char*>(map.first), map.second);
+    }
+  }
+
+  // Maps the cache file
+  //
+  // Returns: false if the file is missing, corrupted or written by
+  // another build, the cache is empty then
+  bool Open() {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (map_) {
+      retired_maps_.emplace_back(map_, map_size_);
+      map_ = nullptr;
+      map_size_ = 0;
+    }
+    index_.clear();
+
+    int fd = ::open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      return false;
+    }
+
+    struct stat st;
+    void* map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size >= static_cast<off_t>(
+                                                 sizeof(Header))) {
+      map = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ,
+                 MAP_PRIVATE, fd, 0);
+    }
+    ::close(fd);
+
+    if (map == MAP_FAILED) {
+      return false;
+    }
+
+    map_ = static_cast<char const*>(map);
+    map_size_ = static_cast<size_t>(st.st_size);
+
+    if (!Parse()) {
+      Unmap();
+      index_.clear();
+      return false;
+    }
+    return true;
+  }
+
+  // Finds the entry of the key with the input checksum, the bytes
+  // are in the mapping or, if stored by this process, in memory
+  //
+  // Returns: false on a miss
+  bool Lookup(std::string const& key, uint64_t checksum, void const** data,
+              size_t* size) {
+    std::lock_guard<std::mutex> guard(mutex_);
+
+    auto pit = pending_.find(key);
+    if (pit != pending_.end() && pit->second.checksum == checksum) {
+      hits_++;
+      *data = pit->second.bytes.data();
+      *size = pit->second.bytes.size();
+      return true;
+    }
+
+    auto it = index_.find(key);
+    if (pit == pending_.end() && it != index_.end() &&
+        it->second.checksum == checksum) {
+      hits_++;
+      *data = map_ + it->second.offset;
+      *size = it->second.size;
+      return true;
+    }
+
+    misses_++;
+    return false;
+  }
+
+  // Stores the entry for the next Commit(), replaces the entry
+  // of the same key
+  //
+  // Returns: the stored copy of the bytes
+  void const* Store(std::string const& key, uint64_t checksum,
+                    std::vector<char>&& bytes) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    Pending& entry = pending_[key];
+    if (!entry.bytes.empty()) {
+      retired_bytes_.push_back(std::move(entry.bytes));
+    }
+    entry.checksum = checksum;
+    entry.bytes = std::move(bytes);
+    return entry.bytes.data();
+  }
+
+  // Writes mapped entries not replaced by Store() and stored
+  // entries into a new file and renames it over the cache file.
+  // Does nothing if nothing was stored.
+  //
+  // Returns: false on i/o errors, the cache file is left intact
+  bool Commit() {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (pending_.empty()) {
+      return true;
+    }
+
+    // (key, checksum, data, size) of all entries
+    struct Out {
+      std::string const* key;
+      uint64_t checksum;
+      char const* data;
+      uint64_t size;
+    };
+    std::vector<Out> out;
+    for (auto const& item : index_) {
+      if (pending_.find(item.first) == pending_.end()) {
+        out.push_back(Out{&item.first, item.second.checksum,
+                          map_ + item.second.offset, item.second.size});
+      }
+    }
+    for (auto const& item : pending_) {
+      out.push_back(Out{&item.first, item.second.checksum,
+                        item.second.bytes.data(), item.second.bytes.size()});
+    }
+
+    // Header, entry table, keys, then aligned data
+    std::vector<char> meta(sizeof(Header) + out.size() * sizeof(Entry));
+    uint64_t offset = meta.size();
+    for (auto const& item : out) {
+      offset += item.key->size();
+    }
+
+    Header header;
+    memcpy(header.magic, Magic(), sizeof(header.magic));
+    header.version = kVersion;
+    header.count = static_cast<uint32_t>(out.size());
+    header.build_id = build_id_;
+
+    std::string keys;
+    std::vector<uint64_t> offsets(out.size());
+    for (size_t i = 0; i < out.size(); i++) {
+      offsets[i] = offset = Align(offset);
+      Entry entry = {out[i].checksum, offset, out[i].size,
+                     out[i].key->size()};
+      memcpy(&meta[sizeof(Header) + i * sizeof(Entry)], &entry,
+             sizeof(entry));
+      keys += *out[i].key;
+      offset += out[i].size;
+    }
+    header.file_size = offset;
+    header.meta_checksum = 0;
+    memcpy(&meta[0], &header, sizeof(header));
+    meta.insert(meta.end(), keys.begin(), keys.end());
+
+    header.meta_checksum = Checksum(meta.data(), meta.size());
+    memcpy(&meta[0], &header, sizeof(header));
+
+    std::string tmp = path_ + ".tmp." + std::to_string(getpid());
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                    0644);
+    if (fd < 0) {
+      return false;
+    }
+
+    bool res = Write(fd, meta.data(), meta.size());
+    uint64_t pos = meta.size();
+    for (size_t i = 0; res && i < out.size(); i++) {
+      static char const zeros[kAlign] = {};
+      res = Write(fd, zeros, offsets[i] - pos) &&
+            Write(fd, out[i].data, out[i].size);
+      pos = offsets[i] + out[i].size;
+    }
+    res = res && fsync(fd) == 0;
+    res = (::close(fd) == 0) && res;
+
+    if (!res || rename(tmp.c_str(), path_.c_str()) != 0) {
+      unlink(tmp.c_str());
+      return false;
+    }
+    return true;
+  }
+
+  size_t GetHits() const {
+    std::lock_guard<std::mutex> guard(mutex_);
+    return hits_;
+  }
+
+  size_t GetMisses() const {
+    std::lock_guard<std::mutex> guard(mutex_);
+    return misses_;
+  }
+
+  // FNV-1a, for input checksums and build ids
+  static uint64_t Checksum(void const* data, size_t size,
+                           uint64_t seed = 14695981039346656037ULL) noexcept {
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; i++) {
+      hash ^= static_cast<unsigned char const*>(data)[i];
+      hash *= 1099511628211ULL;
+    }
+    return hash;
+  }
+
+  // Id of the running binary: the GNU build id if the executable
+  // has one, otherwise its size and modification time
+  static std::string GetBinaryId() {
+    std::string id;
+    dl_iterate_phdr(&FindBuildId, &id);
+    if (!id.empty()) {
+      return id;
+    }
+
+    struct stat st;
+    if (stat("/proc/self/exe", &st) == 0) {
+      id = std::to_string(st.st_size) + ":" + std::to_string(st.st_mtime);
+    }
+    return id;
+  }
+
+ private:
+  static char const* Magic() noexcept { return "ICWARM\0\0"; }
+  static uint32_t const kVersion = 1;
+  static uint64_t const kAlign = 16;
+
+  struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t count;          // Number of entries
+    uint64_t build_id;       // Checksum of the build id
+    uint64_t file_size;      // Expected file size
+    uint64_t meta_checksum;  // Header, entries and keys
+  };
+
+  struct Entry {
+    uint64_t checksum;  // Input checksum
+    uint64_t offset;    // Data offset in the file
+    uint64_t size;      // Data size
+    uint64_t key_size;  // Key length, keys follow the entries
+  };
+
+  struct Mapped {
+    uint64_t checksum;
+    uint64_t offset;
+    uint64_t size;
+  };
+
+  struct Pending {
+    uint64_t checksum;
+    std::vector<char> bytes;
+  };
+
+  static uint64_t Align(uint64_t offset) noexcept {
+    return (offset + kAlign - 1) & ~(kAlign - 1);
+  }
+
+  static bool Write(int fd, void const* data, size_t size) noexcept {
+    char const* cur = static_cast<char const*>(data);
+    while (size > 0) {
+      ssize_t res = ::write(fd, cur, size);
+      if (res < 0) {
+        return false;
+      }
+      cur += res;
+      size -= static_cast<size_t>(res);
+    }
+    return true;
+  }
+
+  // Validates the mapping and builds the index
+  bool Parse() {
+    Header header;
+    memcpy(&header, map_, sizeof(header));
+    if (memcmp(header.magic, Magic(), sizeof(header.magic)) != 0 ||
+        header.version != kVersion || header.build_id != build_id_ ||
+        header.file_size != map_size_) {
+      return false;
+    }
+
+    uint64_t entries_end =
+        sizeof(Header) + static_cast<uint64_t>(header.count) * sizeof(Entry);
+    if (entries_end > map_size_) {
+      return false;
+    }
+
+    uint64_t keys_end = entries_end;
+    std::vector<Entry> entries(header.count);
+    if (header.count) {
+      memcpy(entries.data(), map_ + sizeof(Header),
+             header.count * sizeof(Entry));
+    }
+    for (auto const& entry : entries) {
+      keys_end += entry.key_size;
+      if (keys_end > map_size_) {
+        return false;
+      }
+    }
+
+    Header zeroed = header;
+    zeroed.meta_checksum = 0;
+    uint64_t sum = Checksum(&zeroed, sizeof(zeroed));
+    sum = Checksum(map_ + sizeof(Header), keys_end - sizeof(Header), sum);
+    if (sum != header.meta_checksum) {
+      return false;
+    }
+
+    uint64_t key_offset = entries_end;
+    for (auto const& entry : entries) {
+      if (entry.offset < keys_end || entry.offset > map_size_ ||
+          entry.size > map_size_ - entry.offset) {
+        return false;
+      }
+      std::string key(map_ + key_offset, entry.key_size);
+      key_offset += entry.key_size;
+      index_[key] = Mapped{entry.checksum, entry.offset, entry.size};
+    }
+    return true;
+  }
+
+  void Unmap() noexcept {
+    if (map_) {
+      munmap(const_cast<char*>(map_), map_size_);
+      map_ = nullptr;
+      map_size_ = 0;
+    }
+  }
+
+  static int FindBuildId(struct dl_phdr_info* info, size_t, void* data) {
+    // The first object is the executable
+    std::string* id = static_cast<std::string*>(data);
+    for (int i = 0; i < info->dlpi_phnum; i++) {
+      ElfW(Phdr) const& phdr = info->dlpi_phdr[i];
+      if (phdr.p_type != PT_NOTE) {
+        continue;
+      }
+
+      char const* cur =
+          reinterpret_cast<char const*>(info->dlpi_addr + phdr.p_vaddr);
+      char const* end = cur + phdr.p_memsz;
+      while (cur + sizeof(ElfW(Nhdr)) <= end) {
+        ElfW(Nhdr) const* note = reinterpret_cast<ElfW(Nhdr) const*>(cur);
+        char const* name = cur + sizeof(ElfW(Nhdr));
+        char const* desc = name + ((note->n_namesz + 3) & ~3U);
+        if (note->n_type == NT_GNU_BUILD_ID && note->n_namesz == 4 &&
+            memcmp(name, "GNU", 4) == 0) {
+          static char const hex[] = "0123456789abcdef";
+          for (size_t j = 0; j < note->n_descsz; j++) {
+            unsigned char byte = static_cast<unsigned char>(desc[j]);
+            *id += hex[byte >> 4];
+            *id += hex[byte & 0xf];
+          }
+          return 1;
+        }
+        cur = desc + ((note->n_descsz + 3) & ~3U);
+      }
+    }
+    return 1;
+  }
+
+  mutable std::mutex mutex_;
+  std::string path_;
+  uint64_t build_id_;
+  char const* map_;
+  size_t map_size_;
+  std::map<std::string, Mapped> index_;
+  std::map<std::string, Pending> pending_;
+  std::vector<std::pair<char const*, size_t>> retired_maps_;
+  std::vector<std::vector<char>> retired_bytes_;
+  size_t hits_;
+  size_t misses_;
+};
+
+// Warm start state and init function of WarmStartLink, kept in
+// a base preceding the link, so it is constructed before the link
+// is registered
+class WarmStart {
+ public:
+  using ChecksumFunc = std::function<uint64_t()>;
+  using LoadFunc = std::function<bool(void const* data, size_t size)>;
+  using BuildFunc = std::function<bool(std::vector<char>* out)>;
+
+ protected:
+  WarmStart(WarmCache* cache, std::string const& key, ChecksumFunc checksum,
+            LoadFunc load, BuildFunc build)
+      : cache_(cache),
+        key_(key),
+        checksum_(checksum),
+        load_(load),
+        build_(build) {}
+
+  std::function<bool()> InitFunc() {
+    return [this]() { return Init(); };
+  }
+
+ private:
+  // On a hit only load is called, on a miss build is called, the
+  // result is stored into the cache and handed to load
+  bool Init() {
+    uint64_t checksum = checksum_();
+    void const* data = nullptr;
+    size_t size = 0;
+    if (cache_->Lookup(key_, checksum, &data, &size) && load_(data, size)) {
+      return true;
+    }
+
+    std::vector<char> out;
+    if (!build_(&out)) {
+      return false;
+    }
+    size = out.size();
+    data = cache_->Store(key_, checksum, std::move(out));
+    return load_(data, size);
+  }
+
+  WarmCache* cache_;
+  std::string key_;
+  ChecksumFunc checksum_;
+  LoadFunc load_;
+  BuildFunc build_;
+};
+
+// Link of the CHAIN with the warm start:
+//
+//   checksum - returns the checksum of the inputs, e.g. computed
+//              with WarmCache::Checksum()
+//   load     - takes the serialized result, the bytes stay valid
+//              while the cache exists, returns false if they could
+//              not be used
+//   build    - computes the result from scratch and serializes it,
+//              returns false on failure
+//   reset    - optional reset function
+template <typename CHAIN>
+class WarmStartLink : private WarmStart, public CHAIN::Link {
+ public:
+  using WarmStart::BuildFunc;
+  using WarmStart::ChecksumFunc;
+  using WarmStart::LoadFunc;
+
+  WarmStartLink(int level, WarmCache* cache, std::string const& key,
+                ChecksumFunc checksum, LoadFunc load, BuildFunc build,
+                std::function<bool()> reset = nullptr)
+      : WarmStart(cache, key, checksum, load, build),
+        CHAIN::Link(level, InitFunc(), reset) {}
+};
+
+}  // namespace simple
+
+#endif  // INIT_CHAIN_CACHE_H_
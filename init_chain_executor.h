@@ -0,0 +1,120 @@
+// Copyright (C) 2020  Aleksey Romanov (aleksey at voltanet dot io)
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef INIT_CHAIN_EXECUTOR_H_
+#define INIT_CHAIN_EXECUTOR_H_
+
+#include <condition_variable>  // NOLINT we need the standard condition variable
+#include <cstddef>
+#include <functional>
+#include <mutex>   // NOLINT we need the standard mutex
+#include <thread>  // NOLINT we need the standard thread
+#include <utility>
+
+#if __cplusplus < 201103L
+#error "At least c++11 is required"
+#endif
+
+// Executors running the workers of parallel levels, see
+// Runner::DoSetParallel() and Runner::DoSetExecutor(). An executor
+// is a class with
+//
+//   bool Submit(std::function<void()> task) noexcept;
+//
+// running the task on this or another thread, or returning false
+// if it could not. The chain waits for its tasks with a WaitGroup.
+// The calling thread runs a worker too, so an executor with N
+// threads runs up to N + 1 links of a level at once.
+//
+// Tasks capture a single pointer, so they are kept inside
+// std::function without allocations.
+//
+// See README.md and comments in init_chain.inc for details
+//
+
+namespace simple {
+
+// Number of tasks in flight
+class WaitGroup final {
+ public:
+  WaitGroup() noexcept : count_() {}
+
+  WaitGroup(WaitGroup const& other) = delete;
+  WaitGroup(WaitGroup&& other) = delete;
+  WaitGroup& operator=(WaitGroup const& other) = delete;
+  WaitGroup& operator=(WaitGroup&& other) = delete;
+
+  void Add(size_t count = 1) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    count_ += count;
+  }
+
+  void Done() {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (--count_ == 0) {
+      done_.notify_all();
+    }
+  }
+
+  // Waits until all added tasks are done
+  void Wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return count_ == 0; });
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable done_;
+  size_t count_;
+};
+
+// Runs the task right away on the calling thread: the links of a
+// parallel level run one by one on the thread calling Run(), as if
+// the level was not parallel
+class InlineExecutor final {
+ public:
+  bool Submit(std::function<void()> task) noexcept {
+    task();
+    return true;
+  }
+};
+
+// Runs every task on a new thread
+class ThreadExecutor final {
+ public:
+  bool Submit(std::function<void()> task) noexcept {
+#ifdef INIT_CHAIN_NO_EXCEPTIONS
+    std::thread(std::move(task)).detach();
+#else
+    try {
+      std::thread(std::move(task)).detach();
+    } catch (...) {
+      return false;
+    }
+#endif
+    return true;
+  }
+};
+
+}  // namespace simple
+
+#endif  // INIT_CHAIN_EXECUTOR_H_
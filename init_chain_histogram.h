@@ -0,0 +1,365 @@
+// Copyright (C) 2020  Aleksey Romanov (aleksey at voltanet dot io)
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef INIT_CHAIN_HISTOGRAM_H_
+#define INIT_CHAIN_HISTOGRAM_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#if __cplusplus < 201103L
+#error "At least c++11 is required"
+#endif
+
+// Latency histograms of init and reset functions, recorded per
+// link if INIT_CHAIN_HISTOGRAMS is defined, see
+// Runner::DoGetHistograms().
+//
+// The histogram is HDR style: values are grouped by powers of two
+// and every group is split into 8 linear buckets, so a value is
+// reported within 12.5%. Memory is fixed (about 1.2K), recording
+// is a few relaxed atomic increments, no locks. Histograms are
+// merged directly or through a compact binary dump, e.g. written
+// by every process of a fleet and merged offline.
+//
+// See README.md for details
+//
+
+namespace simple {
+
+class LatencyHistogram final {
+ public:
+  static unsigned const kSubBits = 3;               // 8 buckets per group
+  static unsigned const kMaxBits = 40;              // Up to 2^40 ns (~18m)
+  static unsigned const kSubBuckets = 1u << kSubBits;
+  static unsigned const kBuckets = kSubBuckets * (kMaxBits - kSubBits + 1);
+
+  LatencyHistogram() noexcept { Clear(); }
+
+  LatencyHistogram(LatencyHistogram const& other) noexcept {
+    CopyFrom(other);
+  }
+
+  LatencyHistogram& operator=(LatencyHistogram const& other) noexcept {
+    if (this != &other) {
+      CopyFrom(other);
+    }
+    return *this;
+  }
+
+  // Records the value, larger than the maximum ones are
+  // recorded as the maximum
+  void Record(uint64_t ns) noexcept {
+    uint64_t value = ns;
+    if (value > kMaxValue) {
+      value = kMaxValue;
+    }
+    counts_[GetIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(value, std::memory_order_relaxed);
+
+    uint64_t cur = min_.load(std::memory_order_relaxed);
+    while (value < cur && !min_.compare_exchange_weak(
+                              cur, value, std::memory_order_relaxed)) {
+    }
+    cur = max_.load(std::memory_order_relaxed);
+    while (value > cur && !max_.compare_exchange_weak(
+                              cur, value, std::memory_order_relaxed)) {
+    }
+  }
+
+  // Adds the values of another histogram
+  void Merge(LatencyHistogram const& other) noexcept {
+    for (unsigned idx = 0; idx < kBuckets; idx++) {
+      AddCount(idx, other.counts_[idx].load(std::memory_order_relaxed));
+    }
+    count_.fetch_add(other.GetCount(), std::memory_order_relaxed);
+    sum_.fetch_add(other.GetSum(), std::memory_order_relaxed);
+
+    uint64_t value = other.min_.load(std::memory_order_relaxed);
+    uint64_t cur = min_.load(std::memory_order_relaxed);
+    while (value < cur && !min_.compare_exchange_weak(
+                              cur, value, std::memory_order_relaxed)) {
+    }
+    value = other.GetMax();
+    cur = max_.load(std::memory_order_relaxed);
+    while (value > cur && !max_.compare_exchange_weak(
+                              cur, value, std::memory_order_relaxed)) {
+    }
+  }
+
+  // Adds the values of a histogram written by Dump()
+  //
+  // Returns: false if the data is not a valid dump, nothing
+  // is added then
+  bool Merge(void const* data, size_t size) noexcept {
+    unsigned char const* pos = static_cast<unsigned char const*>(data);
+    unsigned char const* end = pos + size;
+
+    if (size < kMagicSize || memcmp(data, GetMagic(), kMagicSize) != 0) {
+      return false;
+    }
+    pos += kMagicSize;
+
+    uint64_t sub_bits = 0;
+    uint64_t max_bits = 0;
+    uint64_t buckets = 0;
+    LatencyHistogram other;
+    if (!ReadVarint(&pos, end, &sub_bits) || sub_bits != kSubBits ||
+        !ReadVarint(&pos, end, &max_bits) || max_bits != kMaxBits ||
+        !ReadVarint(&pos, end, &other.count_) ||
+        !ReadVarint(&pos, end, &other.sum_) ||
+        !ReadVarint(&pos, end, &other.min_) ||
+        !ReadVarint(&pos, end, &other.max_) ||
+        !ReadVarint(&pos, end, &buckets) || buckets > kBuckets) {
+      return false;
+    }
+
+    // Non-empty buckets, the index is the distance from the
+    // previous one
+    uint64_t idx = 0;
+    uint64_t total = 0;
+    for (uint64_t cnt = 0; cnt < buckets; cnt++) {
+      uint64_t delta = 0;
+      uint64_t value = 0;
+      if (!ReadVarint(&pos, end, &delta) || !ReadVarint(&pos, end, &value) ||
+          value == 0 || value > UINT32_MAX || delta > kBuckets ||
+          idx + delta >= kBuckets || (cnt != 0 && delta == 0)) {
+        return false;
+      }
+      idx += delta;
+      other.counts_[idx].store(static_cast<uint32_t>(value),
+                               std::memory_order_relaxed);
+      total += value;
+    }
+
+    if (pos != end || total > other.GetCount()) {
+      return false;
+    }
+
+    Merge(other);
+    return true;
+  }
+
+  // Compact binary dump: a magic, the bucket layout, the totals
+  // and varint encoded non-empty buckets
+  std::string Dump() const {
+    std::string out(GetMagic(), kMagicSize);
+    WriteVarint(&out, kSubBits);
+    WriteVarint(&out, kMaxBits);
+    WriteVarint(&out, GetCount());
+    WriteVarint(&out, GetSum());
+    WriteVarint(&out, min_.load(std::memory_order_relaxed));
+    WriteVarint(&out, GetMax());
+
+    uint32_t counts[kBuckets];
+    uint64_t buckets = 0;
+    for (unsigned idx = 0; idx < kBuckets; idx++) {
+      counts[idx] = counts_[idx].load(std::memory_order_relaxed);
+      if (counts[idx]) {
+        buckets++;
+      }
+    }
+
+    WriteVarint(&out, buckets);
+    unsigned prev = 0;
+    for (unsigned idx = 0; idx < kBuckets; idx++) {
+      if (counts[idx]) {
+        WriteVarint(&out, idx - prev);
+        WriteVarint(&out, counts[idx]);
+        prev = idx;
+      }
+    }
+    return out;
+  }
+
+  void Clear() noexcept {
+    for (auto& count : counts_) {
+      count.store(0, std::memory_order_relaxed);
+    }
+    count_.store(0, std::memory_order_relaxed);
+    sum_.store(0, std::memory_order_relaxed);
+    min_.store(UINT64_MAX, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+  }
+
+  uint64_t GetCount() const noexcept {
+    return count_.load(std::memory_order_relaxed);
+  }
+
+  uint64_t GetSum() const noexcept {
+    return sum_.load(std::memory_order_relaxed);
+  }
+
+  // Zero if empty
+  uint64_t GetMin() const noexcept {
+    return GetCount() ? min_.load(std::memory_order_relaxed) : 0;
+  }
+
+  uint64_t GetMax() const noexcept {
+    return max_.load(std::memory_order_relaxed);
+  }
+
+  uint64_t GetMean() const noexcept {
+    uint64_t count = GetCount();
+    return count ? GetSum() / count : 0;
+  }
+
+  // Value at or below which the given percent of the values
+  // fall, the upper bound of its bucket, zero if empty
+  uint64_t GetPercentile(double percent) const noexcept {
+    uint64_t count = GetCount();
+    if (count == 0) {
+      return 0;
+    }
+
+    double rank = percent / 100 * static_cast<double>(count);
+    uint64_t target = rank < 1 ? 1 : static_cast<uint64_t>(rank);
+    if (static_cast<double>(target) < rank) {
+      target++;
+    }
+
+    uint64_t seen = 0;
+    for (unsigned idx = 0; idx < kBuckets; idx++) {
+      seen += counts_[idx].load(std::memory_order_relaxed);
+      if (seen >= target) {
+        uint64_t upper = GetUpper(idx);
+        uint64_t max = GetMax();
+        return upper < max ? upper : max;
+      }
+    }
+    return GetMax();
+  }
+
+  // Values in the bucket, for exporting the buckets
+  uint32_t GetBucketCount(unsigned idx) const noexcept {
+    return idx < kBuckets ? counts_[idx].load(std::memory_order_relaxed) : 0;
+  }
+
+  // Bucket bounds, both inclusive
+  static uint64_t GetLower(unsigned idx) noexcept {
+    if (idx < kSubBuckets) {
+      return idx;
+    }
+    unsigned group = idx / kSubBuckets;
+    uint64_t sub = idx % kSubBuckets;
+    return (kSubBuckets + sub) << (group - 1);
+  }
+
+  static uint64_t GetUpper(unsigned idx) noexcept {
+    if (idx < kSubBuckets) {
+      return idx;
+    }
+    unsigned group = idx / kSubBuckets;
+    return GetLower(idx) + (uint64_t(1) << (group - 1)) - 1;
+  }
+
+  static unsigned GetIndex(uint64_t value) noexcept {
+    if (value < kSubBuckets) {
+      return static_cast<unsigned>(value);
+    }
+    unsigned msb = 63 - static_cast<unsigned>(__builtin_clzll(value));
+    unsigned group = msb - kSubBits + 1;
+    unsigned sub = static_cast<unsigned>(value >> (msb - kSubBits)) &
+                   (kSubBuckets - 1);
+    return group * kSubBuckets + sub;
+  }
+
+ private:
+  static uint64_t const kMaxValue = (uint64_t(1) << kMaxBits) - 1;
+  static size_t const kMagicSize = 4;
+
+  static char const* GetMagic() noexcept { return "ICLH"; }
+
+  void CopyFrom(LatencyHistogram const& other) noexcept {
+    for (unsigned idx = 0; idx < kBuckets; idx++) {
+      counts_[idx].store(other.counts_[idx].load(std::memory_order_relaxed),
+                         std::memory_order_relaxed);
+    }
+    count_.store(other.GetCount(), std::memory_order_relaxed);
+    sum_.store(other.GetSum(), std::memory_order_relaxed);
+    min_.store(other.min_.load(std::memory_order_relaxed),
+               std::memory_order_relaxed);
+    max_.store(other.GetMax(), std::memory_order_relaxed);
+  }
+
+  // Saturates instead of wrapping, merged histograms
+  // could have many values
+  void AddCount(unsigned idx, uint32_t value) noexcept {
+    uint32_t cur = counts_[idx].load(std::memory_order_relaxed);
+    for (;;) {
+      uint32_t sum = cur > UINT32_MAX - value ? UINT32_MAX : cur + value;
+      if (counts_[idx].compare_exchange_weak(cur, sum,
+                                             std::memory_order_relaxed)) {
+        return;
+      }
+    }
+  }
+
+  static void WriteVarint(std::string* out, uint64_t value) {
+    while (value >= 0x80) {
+      out->push_back(static_cast<char>((value & 0x7f) | 0x80));
+      value >>= 7;
+    }
+    out->push_back(static_cast<char>(value));
+  }
+
+  static bool ReadVarint(unsigned char const** pos, unsigned char const* end,
+                         uint64_t* value) noexcept {
+    uint64_t res = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+      if (*pos == end) {
+        return false;
+      }
+      unsigned char byte = *(*pos)++;
+      res |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if (!(byte & 0x80)) {
+        *value = res;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  static bool ReadVarint(unsigned char const** pos, unsigned char const* end,
+                         std::atomic<uint64_t>* value) noexcept {
+    uint64_t res = 0;
+    if (!ReadVarint(pos, end, &res)) {
+      return false;
+    }
+    value->store(res, std::memory_order_relaxed);
+    return true;
+  }
+
+  std::atomic<uint32_t> counts_[kBuckets];
+  std::atomic<uint64_t> count_;
+  std::atomic<uint64_t> sum_;
+  std::atomic<uint64_t> min_;
+  std::atomic<uint64_t> max_;
+};
+
+}  // namespace simple
+
+#endif  // INIT_CHAIN_HISTOGRAM_H_
@@ -0,0 +1,366 @@
+// Copyright (C) 2020  Aleksey Romanov (aleksey at voltanet dot io)
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef INIT_CHAIN_MULTI_H_
+#define INIT_CHAIN_MULTI_H_
+
+#include <climits>
+#include <condition_variable>  // NOLINT we need the standard condition
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>  // NOLINT we need the standard mutex
+#include <string>
+#include <thread>  // NOLINT we need the standard thread
+#include <vector>
+
+#if __cplusplus < 201103L
+#error "At least c++11 is required"
+#endif
+
+// Runs several independent chains, tagged or namespaced, concurrently
+// each one on its own thread.
+//
+// A chain may declare barriers: it does not start links at or above
+// a level until another chain has finished all links up to a level.
+// If the other chain fails first, the waiting chain stops and fails
+// too. Resets are done in the reverse order of the chain completion.
+//
+//   simple::MultiChainRunner runner;
+//   runner.AddChain<simple::InitChain<Net>>("net");
+//   runner.AddChain<simple::InitChain<Db>>("db");
+//
+//   // db does not start level 100 and above until net finished
+//   // all its links up to level 50
+//   runner.AddBarrier("db", 100, "net", 50);
+//
+//   runner.Run();
+//
+// See README.md and comments in init_chain.inc for details
+//
+
+namespace simple {
+
+class MultiChainRunner final {
+ public:
+  MultiChainRunner() noexcept
+      : running_(), deadlock_(), active_(), waiting_() {}
+  MultiChainRunner(MultiChainRunner const& other) = delete;
+  MultiChainRunner(MultiChainRunner&& other) = delete;
+  MultiChainRunner& operator=(MultiChainRunner const& other) = delete;
+  MultiChainRunner& operator=(MultiChainRunner&& other) = delete;
+
+  // Adds the CHAIN under the name
+  //
+  // Returns: false if the name is already used or chains are running
+  template <typename CHAIN>
+  bool AddChain(std::string const& name) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (running_ || Find(name) >= 0) {
+      return false;
+    }
+    chains_.emplace_back(new Adapter<CHAIN>(name));
+    return true;
+  }
+
+  // Chain 'name' does not start links with level >= 'level' until
+  // chain 'other' has finished all its links with level <= 'other_level'.
+  //
+  // INT_MIN as the level delays the start of the chain, INT_MAX as
+  // the other level waits for the completion of the other chain.
+  //
+  // Returns: false if any of the chains is unknown or chains are running
+  bool AddBarrier(std::string const& name, int level, std::string const& other,
+                  int other_level) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    int index = Find(name);
+    int other_index = Find(other);
+    if (running_ || index < 0 || other_index < 0 || index == other_index) {
+      return false;
+    }
+    Barrier barrier = {static_cast<size_t>(index), level,
+                       static_cast<size_t>(other_index), other_level};
+    barriers_.push_back(barrier);
+    return true;
+  }
+
+  // Runs all chains concurrently and waits for their completion.
+  //
+  // If all chains are blocked on barriers the barriers are
+  // broken and chains proceed. A chain waiting on a chain whose
+  // Run() failed does not start the links behind the barrier.
+  //
+  // Returns: true if all chains ran and no barrier was broken
+  bool Run() noexcept {
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      if (running_) {
+        return false;
+      }
+      running_ = true;
+      deadlock_ = false;
+      waiting_ = 0;
+      active_ = chains_.size();
+      order_.clear();
+      for (auto& chain : chains_) {
+        chain->started = false;
+        chain->done = false;
+        chain->result = false;
+        chain->failed = false;
+        chain->level = INT_MIN;
+        chain->Clear();
+      }
+    }
+
+    bool res = true;
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < chains_.size(); i++) {
+      try {
+        workers.emplace_back(&MultiChainRunner::RunChain, this, i);
+      } catch (...) {
+        // Could not start a worker, no thread or no memory,
+        // the chain does not run
+        res = false;
+        Finish(i, false);
+      }
+    }
+
+    for (auto& worker : workers) {
+      worker.join();
+    }
+
+    std::lock_guard<std::mutex> guard(mutex_);
+    running_ = false;
+    if (deadlock_) {
+      res = false;
+    }
+    for (auto& chain : chains_) {
+      res = res && chain->result;
+    }
+    return res;
+  }
+
+  // Resets chains in the reverse order of completion of the
+  // last Run()
+  //
+  // Returns: true if all resets succeeded
+  bool Reset() noexcept {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (running_) {
+      return false;
+    }
+
+    bool res = true;
+    for (auto it = order_.rbegin(); it != order_.rend(); ++it) {
+      res = chains_[*it]->Reset() && res;
+    }
+    order_.clear();
+    return res;
+  }
+
+  // Releases all chains
+  //
+  // Returns: true if all releases succeeded
+  bool Release() noexcept {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (running_) {
+      return false;
+    }
+
+    bool res = true;
+    for (auto& chain : chains_) {
+      res = chain->Release() && res;
+    }
+    return res;
+  }
+
+  // Names of the chains in the order of completion of the last Run()
+  std::vector<std::string> GetCompletionOrder() const {
+    std::lock_guard<std::mutex> guard(mutex_);
+    std::vector<std::string> names;
+    for (size_t index : order_) {
+      names.push_back(chains_[index]->name);
+    }
+    return names;
+  }
+
+ private:
+  // Type erased chain
+  struct Chain {
+    explicit Chain(std::string const& chain_name)
+        : name(chain_name),
+          started(),
+          done(),
+          result(),
+          failed(),
+          level() {}
+    virtual ~Chain() {}
+
+    virtual bool Run(std::function<void(int)> const& hook) noexcept = 0;
+    virtual bool Reset() noexcept = 0;
+    virtual bool Release() noexcept = 0;
+
+    // Stops the run before the next link
+    virtual void Cancel() noexcept = 0;
+    virtual void Clear() noexcept = 0;
+
+    std::string name;
+    bool started;  // Reported the first level
+    bool done;     // Run() returned
+    bool result;   // Result of Run()
+    bool failed;   // Cancelled, a chain it waited on failed
+    int level;     // Highest level reported, lower levels are done
+  };
+
+  template <typename CHAIN>
+  class Adapter final : public Chain, public CHAIN::Runner {
+   public:
+    explicit Adapter(std::string const& chain_name) : Chain(chain_name) {}
+
+    bool Run(std::function<void(int)> const& hook) noexcept override {
+      return this->DoRun(INT_MAX, hook, cancel_);
+    }
+    bool Reset() noexcept override { return this->DoReset(); }
+    bool Release() noexcept override { return this->DoRelease(); }
+
+    void Cancel() noexcept override { cancel_.Cancel(); }
+    void Clear() noexcept override { cancel_.Clear(); }
+
+   private:
+    typename CHAIN::CancelToken cancel_;
+  };
+
+  struct Barrier {
+    size_t chain;
+    int level;
+    size_t other;
+    int other_level;
+  };
+
+  int Find(std::string const& name) const noexcept {
+    for (size_t i = 0; i < chains_.size(); i++) {
+      if (chains_[i]->name == name) {
+        return static_cast<int>(i);
+      }
+    }
+    return -1;
+  }
+
+  // State of the barriers of a chain at a level
+  enum Wait {
+    kPass,     // All other chains are past their levels
+    kBlocked,  // Some other chain is not
+    kFail      // Some other chain failed before its level
+  };
+
+  // Has the chain finished all links up to the level, a chain
+  // whose Run() failed has finished only the levels it reported
+  // past
+  bool Finished(size_t index, int level) const noexcept {
+    Chain const* chain = chains_[index].get();
+    return (chain->done && chain->result) ||
+           (chain->started && chain->level > level);
+  }
+
+  bool Failed(size_t index) const noexcept {
+    Chain const* chain = chains_[index].get();
+    return chain->done && !chain->result;
+  }
+
+  Wait Check(size_t index, int level) const noexcept {
+    Wait wait = kPass;
+    for (auto const& barrier : barriers_) {
+      if (barrier.chain == index && barrier.level <= level &&
+          !Finished(barrier.other, barrier.other_level)) {
+        if (Failed(barrier.other)) {
+          return kFail;
+        }
+        wait = kBlocked;
+      }
+    }
+    return wait;
+  }
+
+  // Level hook of the chain
+  void OnLevel(size_t index, int level) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    Chain* chain = chains_[index].get();
+    if (!chain->started || chain->level < level) {
+      chain->started = true;
+      chain->level = level;
+      cond_.notify_all();
+    }
+
+    for (;;) {
+      Wait wait = Check(index, level);
+      if (wait == kFail) {
+        // Links behind the barrier must not start
+        chain->failed = true;
+        chain->Cancel();
+        break;
+      }
+      if (wait == kPass || deadlock_) {
+        break;
+      }
+
+      waiting_++;
+      if (waiting_ == active_) {
+        // Everybody is waiting on somebody else
+        deadlock_ = true;
+        cond_.notify_all();
+      } else {
+        cond_.wait(lock);
+      }
+      waiting_--;
+    }
+  }
+
+  void Finish(size_t index, bool result) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    Chain* chain = chains_[index].get();
+    chain->done = true;
+    chain->result = result && !chain->failed;
+    order_.push_back(index);
+    active_--;
+    cond_.notify_all();
+  }
+
+  void RunChain(size_t index) {
+    bool res = chains_[index]->Run(
+        [this, index](int level) { OnLevel(index, level); });
+    Finish(index, res);
+  }
+
+  mutable std::mutex mutex_;
+  std::condition_variable cond_;
+  std::vector<std::unique_ptr<Chain>> chains_;
+  std::vector<Barrier> barriers_;
+  std::vector<size_t> order_;  // Completion order
+  bool running_;
+  bool deadlock_;
+  size_t active_;   // Chains not done
+  size_t waiting_;  // Chains blocked on barriers
+};
+
+}  // namespace simple
+
+#endif  // INIT_CHAIN_MULTI_H_
@@ -0,0 +1,375 @@
+// Copyright (C) 2020  Aleksey Romanov (aleksey at voltanet dot io)
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef INIT_CHAIN_SHM_H_
+#define INIT_CHAIN_SHM_H_
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "init_chain_cache.h"
+
+#if __cplusplus < 201103L
+#error "At least c++11 is required"
+#endif
+
+// Host-wide init-once through shared memory (POSIX)
+//
+// Several identical processes on a host building the same large
+// read-only dataset at startup could share it: the first process
+// builds it into a named shared-memory segment, the others map the
+// segment read-only instead of building:
+//
+//   simple::SharedInitLink<simple::InitChain> rules_link(
+//       50, "/app-rules", "/run/app/rules.lock",
+//       [] { return RulesInputChecksum(); },
+//       [](std::vector<char>* out) { return Rules::Compile(out); },
+//       [](void const* data, size_t size) { return Rules::Map(data, size); });
+//
+// The segment is valid if it is complete and built for the same input
+// checksum, which should cover the binary as well, see
+// WarmCache::GetBinaryId(). Builders and readers are serialized by a
+// file lock, a lock of a crashed process is released by the kernel, so
+// a partially built (stale) segment or a segment of other inputs is
+// simply rebuilt by the next process. Processes that mapped the old
+// segment keep it until they unmap it.
+//
+// A reader trusts a ready segment of the same input checksum and size,
+// it neither reads nor faults in the data before "load". The data
+// checksum is verified only if SharedSegment::SetVerify() is set, at
+// the cost of a pass over the data by every process.
+//
+// See README.md and comments in init_chain.inc for details
+//
+
+namespace simple {
+
+class SharedSegment final {
+ public:
+  using BuildFunc = std::function<bool(std::vector<char>* out)>;
+
+  // name      - shared memory object name, e.g. "/app-rules"
+  // lock_path - lock file, created if missing
+  SharedSegment(std::string const& name, std::string const& lock_path)
+      : name_(name),
+        lock_path_(lock_path),
+        map_(),
+        map_size_(),
+        built_(),
+        verify_() {}
+
+  SharedSegment(SharedSegment const& other) = delete;
+  SharedSegment(SharedSegment&& other) = delete;
+  SharedSegment& operator=(SharedSegment const& other) = delete;
+  SharedSegment& operator=(SharedSegment&& other) = delete;
+
+  ~SharedSegment() { Release(); }
+
+  // Maps the segment built for the checksum, if it is missing,
+  // stale or built for other inputs builds it first
+  //
+  // Returns: false if the build failed or on system errors
+  bool Acquire(uint64_t checksum, BuildFunc const& build) {
+    Release();
+    built_ = false;
+
+    int lock_fd = ::open(lock_path_.c_str(), O_RDWR | O_CREAT | O_CLOEXEC,
+                         0644);
+    if (lock_fd < 0) {
+      return false;
+    }
+
+    // Readers share the lock, the common case
+    bool res = Lock(lock_fd, LOCK_SH) && Map(checksum);
+    if (!res) {
+      // Exclusive for the build, someone could have built it
+      // between the locks
+      res = Lock(lock_fd, LOCK_EX) &&
+            (Map(checksum) || (Build(checksum, build) && Map(checksum)));
+    }
+
+    ::close(lock_fd);
+    return res;
+  }
+
+  // Unmaps the segment, it stays for other processes
+  void Release() noexcept {
+    if (map_) {
+      munmap(const_cast<char*>(map_), map_size_);
+      map_ = nullptr;
+      map_size_ = 0;
+    }
+  }
+
+  // Removes the segment host-wide, mappings stay valid
+  //
+  // Returns: false on system errors
+  bool Remove() {
+    int lock_fd = ::open(lock_path_.c_str(), O_RDWR | O_CREAT | O_CLOEXEC,
+                         0644);
+    if (lock_fd < 0) {
+      return false;
+    }
+
+    bool res = Lock(lock_fd, LOCK_EX) &&
+               (shm_unlink(name_.c_str()) == 0 || errno == ENOENT);
+    ::close(lock_fd);
+    return res;
+  }
+
+  // Mapped data, valid until Release()
+  void const* GetData() const noexcept {
+    return map_ ? map_ + sizeof(Header) : nullptr;
+  }
+
+  size_t GetSize() const noexcept {
+    return map_ ? map_size_ - sizeof(Header) : 0;
+  }
+
+  // True if the segment was built by this process
+  bool IsBuilt() const noexcept { return built_; }
+
+  // Checksum the data of a mapped segment, a corrupted one is
+  // rebuilt. Should be set before Acquire().
+  void SetVerify(bool val) noexcept { verify_ = val; }
+
+ private:
+  static char const* Magic() noexcept { return "ICSHM\0\0\0"; }
+  static uint32_t const kVersion = 1;
+  static uint32_t const kReady = 1;
+
+  // Data follows the header
+  struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t state;          // kReady once the data is complete
+    uint64_t checksum;       // Input checksum
+    uint64_t size;           // Data size
+    uint64_t data_checksum;  // Data, checked if verification is set
+    uint64_t reserved[3];
+  };
+
+  static bool Lock(int fd, int op) noexcept {
+    int res;
+    do {
+      res = flock(fd, op);
+    } while (res != 0 && errno == EINTR);
+    return res == 0;
+  }
+
+  // Maps the segment read-only if it is valid for the checksum.
+  // Called under the lock
+  bool Map(uint64_t checksum) {
+    int fd = shm_open(name_.c_str(), O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0) {
+      return false;
+    }
+
+    struct stat st;
+    void* map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 &&
+        st.st_size >= static_cast<off_t>(sizeof(Header))) {
+      map = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ,
+                 MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+
+    if (map == MAP_FAILED) {
+      return false;
+    }
+
+    char const* base = static_cast<char const*>(map);
+    size_t size = static_cast<size_t>(st.st_size);
+    Header header;
+    memcpy(&header, base, sizeof(header));
+    if (memcmp(header.magic, Magic(), sizeof(header.magic)) != 0 ||
+        header.version != kVersion || header.state != kReady ||
+        header.checksum != checksum ||
+        header.size != size - sizeof(Header) ||
+        (verify_ && header.data_checksum !=
+                        WarmCache::Checksum(base + sizeof(Header),
+                                            header.size))) {
+      munmap(map, size);
+      return false;
+    }
+
+    map_ = base;
+    map_size_ = size;
+    return true;
+  }
+
+  // Replaces whatever is there by a new segment, the header is
+  // marked ready after the data is written. Called under the
+  // exclusive lock
+  bool Build(uint64_t checksum, BuildFunc const& build) {
+    std::vector<char> out;
+    if (!build(&out)) {
+      return false;
+    }
+
+    // Stale segment, or one of other inputs
+    shm_unlink(name_.c_str());
+
+    int fd = shm_open(name_.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC,
+                      0644);
+    if (fd < 0) {
+      return false;
+    }
+
+    size_t size = sizeof(Header) + out.size();
+    void* map = MAP_FAILED;
+    if (ftruncate(fd, static_cast<off_t>(size)) == 0) {
+      map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+
+    if (map == MAP_FAILED) {
+      shm_unlink(name_.c_str());
+      return false;
+    }
+
+    char* base = static_cast<char*>(map);
+    if (!out.empty()) {
+      memcpy(base + sizeof(Header), out.data(), out.size());
+    }
+
+    Header header = {};
+    memcpy(header.magic, Magic(), sizeof(header.magic));
+    header.version = kVersion;
+    header.checksum = checksum;
+    header.size = out.size();
+    header.data_checksum = WarmCache::Checksum(out.data(), out.size());
+    memcpy(base, &header, sizeof(header));
+
+    // Complete, readers look at the state
+    header.state = kReady;
+    memcpy(base, &header, sizeof(header));
+    munmap(map, size);
+
+    built_ = true;
+    return true;
+  }
+
+  std::string name_;
+  std::string lock_path_;
+  char const* map_;
+  size_t map_size_;
+  bool built_;
+  bool verify_;
+};
+
+// Shared segment and init/reset functions of SharedInitLink, kept in
+// a base preceding the link, so it is constructed before the link is
+// registered
+class SharedInit {
+ public:
+  using ChecksumFunc = std::function<uint64_t()>;
+  using BuildFunc = SharedSegment::BuildFunc;
+  using LoadFunc = std::function<bool(void const* data, size_t size)>;
+
+  SharedSegment& GetSegment() noexcept { return segment_; }
+
+ protected:
+  SharedInit(std::string const& name, std::string const& lock_path,
+             ChecksumFunc checksum, BuildFunc build, LoadFunc load,
+             std::function<bool()> reset)
+      : segment_(name, lock_path),
+        checksum_(checksum),
+        build_(build),
+        load_(load),
+        reset_(reset) {}
+
+  std::function<bool()> InitFunc() {
+    return [this]() { return Init(); };
+  }
+
+  std::function<bool()> ResetFunc() {
+    return [this]() { return Reset(); };
+  }
+
+ private:
+  bool Init() {
+    if (!segment_.Acquire(checksum_(), build_)) {
+      return false;
+    }
+    return load_(segment_.GetData(), segment_.GetSize());
+  }
+
+  // The data is unmapped after the user reset, the next
+  // init maps it again
+  bool Reset() {
+    bool res = reset_ ? reset_() : true;
+    segment_.Release();
+    return res;
+  }
+
+  SharedSegment segment_;
+  ChecksumFunc checksum_;
+  BuildFunc build_;
+  LoadFunc load_;
+  std::function<bool()> reset_;
+};
+
+// Link of the CHAIN with the result shared host-wide:
+//
+//   name      - shared memory object name, e.g. "/app-rules"
+//   lock_path - lock file serializing the builders
+//   checksum  - returns the checksum of the inputs, e.g. computed
+//               with WarmCache::Checksum()
+//   build     - computes the result from scratch and serializes it,
+//               called by one process of the host, returns false
+//               on failure
+//   load      - takes the read-only serialized result, the bytes
+//               stay valid until the reset, returns false if they
+//               could not be used
+//   reset     - optional reset function, called before the
+//               segment is unmapped
+template <typename CHAIN>
+class SharedInitLink : private SharedInit, public CHAIN::Link {
+ public:
+  using SharedInit::BuildFunc;
+  using SharedInit::ChecksumFunc;
+  using SharedInit::GetSegment;
+  using SharedInit::LoadFunc;
+
+  SharedInitLink(int level, std::string const& name,
+                 std::string const& lock_path, ChecksumFunc checksum,
+                 BuildFunc build, LoadFunc load,
+                 std::function<bool()> reset = nullptr)
+      : SharedInit(name, lock_path, checksum, build, load, reset),
+        CHAIN::Link(level, InitFunc(), ResetFunc()) {}
+};
+
+}  // namespace simple
+
+#endif  // INIT_CHAIN_SHM_H_
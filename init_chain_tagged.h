@@ -23,8 +23,34 @@
 #ifndef INIT_CHAIN_TAGGED_H_
 #define INIT_CHAIN_TAGGED_H_
 
+#if defined(__linux__)
+#include <pthread.h>
+#include <sys/resource.h>
+#endif
+
+#ifdef INIT_CHAIN_USDT
+#include <sys/sdt.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT we need the standard chrono
+#include <climits>
+#include <condition_variable>  // NOLINT we need the standard condition variable
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <exception>
 #include <functional>
+#include <memory>
 #include <mutex>  // NOLINT we need the standard mutex
+#include <new>
+#include <thread>  // NOLINT we need the standard thread
+#include <utility>
+#include <vector>
+
+#include "init_chain_executor.h"
+#include "init_chain_histogram.h"
 
 #if __cplusplus < 201103L
 #error "At least c++11 is required"
@@ -45,13 +71,25 @@ namespace simple {
 //
 #define RUN_MUTEX_TYPEDEF
 #define LINK_MUTEX_TYPEDEF
+#define EXECUTOR_TYPEDEF
 
+// EXECUTOR runs the workers of parallel levels, see
+// init_chain_executor.h, by default on the thread calling Run()
 template <typename TAG, typename RUN_MUTEX = std::mutex,
-          typename LINK_MUTEX = std::mutex>
+          typename LINK_MUTEX = std::mutex,
+          typename EXECUTOR = InlineExecutor>
 #include "init_chain.inc"
 
-template <typename TAG, typename RUN_MUTEX, typename LINK_MUTEX>
-bool InitChain<TAG, RUN_MUTEX, LINK_MUTEX>::AllowReset() {
+#ifdef INIT_CHAIN_CONSTINIT
+template <typename TAG, typename RUN_MUTEX, typename LINK_MUTEX,
+          typename EXECUTOR>
+constinit typename InitChain<TAG, RUN_MUTEX, LINK_MUTEX, EXECUTOR>::Bucket
+    InitChain<TAG, RUN_MUTEX, LINK_MUTEX, EXECUTOR>::chain_bucket_{};
+#endif
+
+template <typename TAG, typename RUN_MUTEX, typename LINK_MUTEX,
+          typename EXECUTOR>
+bool InitChain<TAG, RUN_MUTEX, LINK_MUTEX, EXECUTOR>::AllowReset() {
   static_assert(allow_helper(), "use specialised config");
   return false;
 }
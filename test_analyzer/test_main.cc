@@ -0,0 +1,133 @@
+// Copyright (C) 2020  Aleksey Romanov (aleksey at voltanet dot io)
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include <init_chain_analyzer.h>
+
+#include <cassert>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static char const* const kProfile =
+    "# name level duration [dependency ...]\n"
+    "a  10  4\n"
+    "b  10  2\n"
+    "c  20  1  a\n"
+    "d  20  5  b\n"
+    "\n"
+    "e  30  3  c   # comment\n";
+
+static void Load(simple::StartupAnalyzer* analyzer) {
+  std::istringstream in(kProfile);
+  std::string error;
+  bool res = analyzer->Load(in, &error);
+  assert(res);
+  res = analyzer->Analyze(&error);
+  assert(res);
+  (void)res;
+}
+
+static void TestLevelBarriers() {
+  simple::StartupAnalyzer analyzer;
+  Load(&analyzer);
+
+  assert(analyzer.GetTotal() == 15);
+  assert(analyzer.GetCriticalPathLength() == 12);
+  assert(analyzer.GetCriticalPath() ==
+         std::vector<std::string>({"a", "d", "e"}));
+
+  assert(analyzer.GetMakespan(1) == 15);
+  assert(analyzer.GetMakespan(2) == 12);
+  assert(analyzer.GetMakespanBound(1) == 15);
+  assert(analyzer.GetMakespanBound(2) == 12);
+
+  std::vector<simple::StartupAnalyzer::LevelGap> gaps =
+      analyzer.GetLevelGaps(2);
+  assert(gaps.size() == 3);
+  assert(gaps[0].level == 10 && gaps[0].start == 0 && gaps[0].finish == 4);
+  assert(gaps[0].busy == 6 && gaps[0].idle == 2);
+  assert(gaps[1].level == 20 && gaps[1].start == 4 && gaps[1].finish == 9);
+  assert(gaps[1].busy == 6 && gaps[1].idle == 4);
+  assert(gaps[2].level == 30 && gaps[2].idle == 3);
+
+  assert(analyzer.GetTopLinks(2) == std::vector<std::string>({"d", "a"}));
+
+  std::ostringstream dot;
+  analyzer.WriteDot(dot);
+  assert(dot.str().find("n0 -> n2;") != std::string::npos);
+  assert(dot.str().find("n3 -> n4 [style=dashed color=red];") !=
+         std::string::npos);
+
+  std::ostringstream json;
+  analyzer.WriteJson(json);
+  assert(json.str().find("\"critical_path\": [\"a\", \"d\", \"e\"]") !=
+         std::string::npos);
+}
+
+static void TestDependencies() {
+  simple::StartupAnalyzer analyzer;
+  analyzer.SetLevelBarriers(false);
+  Load(&analyzer);
+
+  assert(analyzer.GetCriticalPathLength() == 8);
+  assert(analyzer.GetCriticalPath() == std::vector<std::string>({"a", "c",
+                                                                 "e"}));
+  assert(analyzer.GetMakespan(1) == 15);
+  assert(analyzer.GetMakespan(2) == 8);
+  assert(analyzer.GetMakespan(4) == 8);
+}
+
+static void TestErrors() {
+  std::string error;
+
+  simple::StartupAnalyzer bad_line;
+  std::istringstream line("a 10\n");
+  assert(!bad_line.Load(line, &error));
+  assert(error == "bad profile line 1");
+
+  simple::StartupAnalyzer unknown;
+  unknown.Add({"a", 10, 1, {"x"}});
+  assert(!unknown.Analyze(&error));
+  assert(error == "unknown dependency x of a");
+
+  simple::StartupAnalyzer upward;
+  upward.Add({"a", 10, 1, {"b"}});
+  upward.Add({"b", 20, 1, {}});
+  assert(!upward.Analyze(&error));
+  upward.SetLevelBarriers(false);
+  assert(upward.Analyze(&error));
+
+  simple::StartupAnalyzer cycle;
+  cycle.Add({"a", 10, 1, {"b"}});
+  cycle.Add({"b", 10, 1, {"a"}});
+  assert(!cycle.Analyze(&error));
+  assert(error == "dependency cycle");
+}
+
+int main() {
+  TestLevelBarriers();
+  TestDependencies();
+  TestErrors();
+  std::cout << "Success\n";
+  return 0;
+}
@@ -0,0 +1,175 @@
+// Copyright (C) 2020  Aleksey Romanov (aleksey at voltanet dot io)
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include <init_chain.h>
+#include <init_chain_cache.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+bool simple::InitChain::AllowReset() { return true; }
+
+class TestRunner : public simple::InitChain::Runner {
+ public:
+  bool Run() noexcept { return DoRun(); }
+  bool Reset() noexcept { return DoReset(); }
+};
+
+using Link = simple::WarmStartLink<simple::InitChain>;
+
+// Expensive table derived from the input
+static std::string input = "input-1";
+static size_t builds;
+static std::string table;
+static void const* table_data;
+
+static uint64_t InputChecksum() {
+  return simple::WarmCache::Checksum(input.data(), input.size());
+}
+
+static bool Build(std::vector<char>* out) {
+  builds++;
+  std::string res = "table of " + input;
+  out->assign(res.begin(), res.end());
+  return true;
+}
+
+static bool Load(void const* data, size_t size) {
+  table.assign(static_cast<char const*>(data), size);
+  table_data = data;
+  return true;
+}
+
+// Runs the link with the cache, returns true on a warm start
+static bool Start(std::string const& path, std::string const& build_id,
+                  bool expect_open) {
+  TestRunner runner;
+  simple::WarmCache cache(path, build_id);
+  bool res = cache.Open();
+  assert(res == expect_open);
+
+  size_t prev_builds = builds;
+  {
+    Link link(10, &cache, "table", &InputChecksum, &Load, &Build);
+    res = runner.Run();
+    assert(res);
+    assert(table == "table of " + input);
+    res = runner.Reset();
+    assert(res);
+  }
+
+  res = cache.Commit();
+  assert(res);
+  assert(cache.GetHits() + cache.GetMisses() == 1);
+  (void)res;
+  return builds == prev_builds;
+}
+
+int main(int argc, char**) {
+  if (argc != 1) {
+    std::cout << "unexpected parameters\n";
+    return 1;
+  }
+
+  char dir[] = "/tmp/test_cache_XXXXXX";
+  if (!mkdtemp(dir)) {
+    std::cout << "cannot create temporary directory\n";
+    return 1;
+  }
+  std::string path = std::string(dir) + "/init.cache";
+  std::string build_id = simple::WarmCache::GetBinaryId();
+  assert(!build_id.empty());
+
+  // Cold start: no file, the table is built and stored
+  bool warm = Start(path, build_id, false);
+  assert(!warm);
+
+  // Warm start: the table comes from the mapping
+  warm = Start(path, build_id, true);
+  assert(warm);
+
+  // Input changed: rebuilt
+  input = "input-2";
+  warm = Start(path, build_id, true);
+  assert(!warm);
+  warm = Start(path, build_id, true);
+  assert(warm);
+
+  // Another build: the file is ignored
+  warm = Start(path, build_id + "-other", false);
+  assert(!warm);
+  warm = Start(path, build_id + "-other", true);
+  assert(warm);
+
+  // Zero copy: the bytes are handed out of the mapping
+  {
+    simple::WarmCache cache(path, build_id + "-other");
+    bool res = cache.Open();
+    assert(res);
+    void const* data = nullptr;
+    size_t size = 0;
+    res = cache.Lookup("table", InputChecksum(), &data, &size);
+    assert(res);
+    assert(size == table.size());
+    assert(memcmp(data, table.data(), size) == 0);
+    assert(reinterpret_cast<uintptr_t>(data) % 16 == 0);
+    res = cache.Lookup("table", InputChecksum() + 1, &data, &size);
+    assert(!res);
+
+    // Bytes outlive a reopen and a replacing store
+    res = cache.Open();
+    assert(res);
+    assert(memcmp(data, table.data(), size) == 0);
+
+    void const* stored = cache.Store("table", 1, std::vector<char>(64, 'a'));
+    cache.Store("table", 2, std::vector<char>(64, 'b'));
+    assert(memcmp(stored, std::string(64, 'a').data(), 64) == 0);
+    assert(memcmp(data, table.data(), size) == 0);
+    (void)res;
+    (void)stored;
+  }
+
+  // Corrupted file: ignored and rewritten
+  {
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(48);
+    file.put('X');
+  }
+  warm = Start(path, build_id + "-other", false);
+  assert(!warm);
+  warm = Start(path, build_id + "-other", true);
+  assert(warm);
+
+  unlink(path.c_str());
+  rmdir(dir);
+  (void)warm;
+  (void)table_data;
+  return 0;
+}
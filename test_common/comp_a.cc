@@ -31,6 +31,9 @@
 
 CompA* CompA::self_;
 
+// Recorder id of the component
+static size_t const kRecorderId = Recorder::GetId("a");
+
 // Also, we are exercising usage of negative levels.
 int const CompA::init_level_ = -10;
 
@@ -46,7 +49,7 @@ CompA::~CompA() { self_ = nullptr; }
 bool CompA::Init() {
   std::cout << "Component-a: init function called: level=" << init_level_
             << std::endl;
-  Recorder::SetState("a", true);
+  Recorder::SetState(kRecorderId, true);
   Recorder::CountInit(init_level_);
 
   // There is no reset-func so return value does not matter
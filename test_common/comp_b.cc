@@ -31,7 +31,10 @@
 #include <string>
 
 CompB* CompB::self_;
-int const CompB::init_level_ = 15;
+
+// Recorder id of the component
+static size_t const kRecorderId = Recorder::GetId("b");
+constexpr int CompB::init_level_;
 
 CompB& CompB::GetInstance() noexcept {
   assert(self_ != nullptr);
@@ -58,7 +61,7 @@ CompB::~CompB() {
 bool CompB::Init() {
   std::cout << "Component-b: init function called: level=" << init_level_
             << std::endl;
-  Recorder::SetState("b", true);
+  Recorder::SetState(kRecorderId, true);
   Recorder::CountInit(init_level_);
 
   if (self_) {
@@ -77,7 +80,7 @@ bool CompB::Init() {
 bool CompB::Reset() {
   std::cout << "Component-b: reset function called: level=" << init_level_
             << std::endl;
-  Recorder::SetState("b", false);
+  Recorder::SetState(kRecorderId, false);
   Recorder::CountReset(init_level_);
 
   // Demonstrate delete of the owning singleton
@@ -88,4 +91,5 @@ bool CompB::Reset() {
 
 // Static chain element
 //
-INIT_CHAIN::Link CompB::init_helper_(init_level_, Init, Reset);
+INIT_CHAIN::StaticLink<CompB::init_level_, &CompB::Init, &CompB::Reset>
+    CompB::init_helper_;
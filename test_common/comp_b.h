@@ -26,7 +26,8 @@
 #include <test_common.h>
 
 // A simple form of initialization: the chain-link object
-// is a static member of the class.
+// is a static member of the class. The level and functions
+// are known at compile time so StaticLink is used.
 //
 
 // Application is a singleton
@@ -53,9 +54,9 @@ class CompB {
   static CompB* self_;
 
   // We use levels for logging so it is a member of the class
-  static int const init_level_;
+  static constexpr int init_level_ = 15;
 
-  static INIT_CHAIN::Link init_helper_;
+  static INIT_CHAIN::StaticLink<init_level_, &Init, &Reset> init_helper_;
 };
 
 #endif  // TEST_COMMON_COMP_B_H_
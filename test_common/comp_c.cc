@@ -32,6 +32,9 @@
 #include <string>
 
 CompC* CompC::self_;
+
+// Recorder id of the component
+static size_t const kRecorderId = Recorder::GetId("c");
 int const CompC::init_level_ = 20;
 
 CompC& CompC::GetInstance() noexcept {
@@ -71,7 +74,7 @@ CompC::InitHelper::InitHelper()
 bool CompC::InitHelper::Init() {
   std::cout << "Component-c: init function called: level=" << init_level_
             << std::endl;
-  Recorder::SetState("c", true);
+  Recorder::SetState(kRecorderId, true);
   Recorder::CountInit(init_level_);
 
   if (self_) {
@@ -100,7 +103,7 @@ bool CompC::InitHelper::Init() {
 bool CompC::InitHelper::Reset() {
   std::cout << "Component-c: reset function called: level=" << init_level_
             << std::endl;
-  Recorder::SetState("c", false);
+  Recorder::SetState(kRecorderId, false);
   Recorder::CountReset(init_level_);
 
   delete self_;
@@ -33,6 +33,9 @@
 #include <string>
 
 CompD* CompD::self_;
+
+// Recorder id of the component
+static size_t const kRecorderId = Recorder::GetId("d");
 bool CompD::failure_armed_;
 bool CompD::exception_armed_;
 
@@ -72,7 +75,13 @@ class CompD::Helper final : public INIT_CHAIN::Link {
   static bool Reset();
 };
 
-CompD::Helper::Helper() : Link(init_level_, Init, Reset) {}
+CompD::Helper::Helper() : Link(init_level_, Init, Reset) {
+  // Pretend there is something to flush at exit
+  SetResetAtExit(true);
+
+  // Shown by tracing tools
+  SetName("component-d");
+}
 
 bool CompD::Helper::Init() {
   if (failure_armed_) {
@@ -93,7 +102,7 @@ bool CompD::Helper::Init() {
 
   std::cout << "Component-d: init function called: level=" << init_level_
             << std::endl;
-  Recorder::SetState("d", true);
+  Recorder::SetState(kRecorderId, true);
   Recorder::CountInit(init_level_);
 
   if (self_) {
@@ -113,7 +122,7 @@ bool CompD::Helper::Init() {
 bool CompD::Helper::Reset() {
   std::cout << "Component-d: reset function called: level=" << init_level_
             << std::endl;
-  Recorder::SetState("d", false);
+  Recorder::SetState(kRecorderId, false);
   Recorder::CountReset(init_level_);
 
   // Demonstrate delete of the owning singleton
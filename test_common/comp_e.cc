@@ -32,18 +32,23 @@
 #include <iostream>
 #include <string>
 
-class CompE::Helper final : public INIT_CHAIN::Link {
+// Recorder id of the component
+static size_t const kRecorderId = Recorder::GetId("e");
+
+// Helpers are allocated from the chain pool, the lambdas capture
+// a single pointer and need no allocations of their own
+class CompE::Helper final : public INIT_CHAIN::PooledLink {
  public:
   Helper(CompE* owner, int level)
-      : Link(level, std::bind(&CompE::Helper::Init, this),
-             std::bind(&CompE::Helper::Reset, this)),
+      : PooledLink(level, [this]() { return Init(); },
+                   [this]() { return Reset(); }),
         owner_(owner) {}
 
  private:
   bool Init() {
     std::cout << "Component-e: init function called: level=" << GetLevel()
               << std::endl;
-    Recorder::SetState("e", true);
+    Recorder::SetState(kRecorderId, true);
     Recorder::CountInit(GetLevel());
 
     owner_->init_done_ = true;
@@ -60,7 +65,7 @@ class CompE::Helper final : public INIT_CHAIN::Link {
   bool Reset() {
     std::cout << "Component-e: reset function called: level=" << GetLevel()
               << std::endl;
-    Recorder::SetState("e", false);
+    Recorder::SetState(kRecorderId, false);
     Recorder::CountReset(GetLevel());
 
     owner_->init_done_ = false;
@@ -77,7 +82,9 @@ class CompE::Helper final : public INIT_CHAIN::Link {
 };
 
 CompE::CompE(int val)
-    : val_(val), init_done_(), helper_(new Helper(this, 40 + val)) {}
+    : val_(val),
+      init_done_(),
+      helper_(new (40 + val) Helper(this, 40 + val)) {}
 
 bool CompE::Check() noexcept { return true; }
 
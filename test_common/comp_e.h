@@ -26,7 +26,8 @@
 // Initialization of multiple instances of CompE class
 // each from its own chain link. Demonstrate delete
 // of one chain link from inside Init function and
-// another one from inside Reset.
+// another one from inside Reset. Chain links are
+// allocated from the chain pool.
 
 #include <memory>
 
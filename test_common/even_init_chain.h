@@ -23,11 +23,36 @@
 #ifndef TEST_COMMON_EVEN_INIT_CHAIN_H_
 #define TEST_COMMON_EVEN_INIT_CHAIN_H_
 
+#if defined(__linux__)
+#include <pthread.h>
+#include <sys/resource.h>
+#endif
+
+#ifdef INIT_CHAIN_USDT
+#include <sys/sdt.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>  // NOLINT we need the standard chrono
+#include <climits>
+#include <condition_variable>  // NOLINT we need the standard condition variable
 #include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <exception>
 #include <functional>
 #include <iostream>
+#include <memory>
 #include <mutex>  // NOLINT we need the standard mutex
+#include <new>
+#include <thread>  // NOLINT we need the standard thread
+#include <utility>
+#include <vector>
+
+#include "init_chain_executor.h"
+#include "init_chain_histogram.h"
 
 #if __cplusplus < 201103L
 #error "At least c++11 is required"
@@ -46,9 +71,14 @@ namespace even {
 
 #define RUN_MUTEX_TYPEDEF using RUN_MUTEX = std::mutex;
 #define LINK_MUTEX_TYPEDEF using LINK_MUTEX = std::mutex;
+#define EXECUTOR_TYPEDEF using EXECUTOR = simple::ThreadExecutor;
 
 #include "init_chain.inc"
 
+#ifdef INIT_CHAIN_CONSTINIT
+constinit inline InitChain::Bucket InitChain::chain_bucket_{};
+#endif
+
 }  // namespace even
 
 #endif  // TEST_COMMON_EVEN_INIT_CHAIN_H_
@@ -21,53 +21,214 @@
 //
 #include <recorder.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>  // NOLINT
+#include <memory>
+#include <mutex>  // NOLINT
 #include <utility>
 
-std::map<int, size_t> Recorder::init_map_;
-std::map<int, size_t> Recorder::reset_map_;
-std::map<std::string, size_t> Recorder::state_map_;
+namespace {
 
-void Recorder::CountInit(int level) {
-  auto res = init_map_.insert(std::make_pair(level, 1));
+// Events of a thread, only the owning thread appends and
+// publishes the count, readers see the published part
+struct Chunk {
+  static size_t const kSize = 1024;
 
-  if (!res.second) {
-    (*res.first).second++;
+  Recorder::Event events[kSize];
+  std::atomic<size_t> count;
+  std::atomic<Chunk*> next;
+
+  Chunk() : count(0), next(nullptr) {}
+};
+
+struct Buffer {
+  Chunk head;
+  Chunk* tail;
+
+  Buffer() : head(), tail(&head) {}
+
+  ~Buffer() {
+    Chunk* cur = head.next.load(std::memory_order_relaxed);
+    while (cur) {
+      Chunk* next = cur->next.load(std::memory_order_relaxed);
+      delete cur;
+      cur = next;
+    }
+  }
+};
+
+// Buffers are kept after their threads exit
+struct Registry {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<Buffer>> buffers;
+  std::vector<std::string> names;
+  std::atomic<size_t> states[Recorder::kMaxComponents];
+
+  Registry() : mutex(), buffers(), names() {
+    for (auto& state : states) {
+      state.store(0, std::memory_order_relaxed);
+    }
   }
+};
+
+Registry& GetRegistry() {
+  static Registry registry;
+  return registry;
 }
 
-void Recorder::CountReset(int level) {
-  auto res = reset_map_.insert(std::make_pair(level, 1));
+Buffer* GetBuffer() {
+  static thread_local Buffer* buffer;
+  if (!buffer) {
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> guard(registry.mutex);
+    registry.buffers.emplace_back(new Buffer());
+    buffer = registry.buffers.back().get();
+  }
+  return buffer;
+}
 
-  if (!res.second) {
-    (*res.first).second++;
+// Visits published events of all buffers
+template <typename VISITOR>
+void Visit(VISITOR visitor) {
+  Registry& registry = GetRegistry();
+  std::lock_guard<std::mutex> guard(registry.mutex);
+  for (auto const& buffer : registry.buffers) {
+    for (Chunk const* cur = &buffer->head; cur;
+         cur = cur->next.load(std::memory_order_acquire)) {
+      size_t count = cur->count.load(std::memory_order_acquire);
+      for (size_t i = 0; i < count; i++) {
+        visitor(cur->events[i]);
+      }
+    }
   }
 }
 
-std::map<int, size_t> const& Recorder::GetInitMap() noexcept {
-  return init_map_;
+}  // namespace
+
+size_t const Recorder::kMaxComponents;
+size_t const Chunk::kSize;
+
+void Recorder::Record(int level, Kind kind) {
+  Buffer* buffer = GetBuffer();
+  Chunk* chunk = buffer->tail;
+  size_t count = chunk->count.load(std::memory_order_relaxed);
+
+  if (count == Chunk::kSize) {
+    Chunk* next = new Chunk();
+    chunk->next.store(next, std::memory_order_release);
+    buffer->tail = chunk = next;
+    count = 0;
+  }
+
+  Event& event = chunk->events[count];
+  event.time_ns = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+  event.level = level;
+  event.kind = kind;
+  chunk->count.store(count + 1, std::memory_order_release);
 }
-std::map<int, size_t> const& Recorder::GetResetMap() noexcept {
-  return reset_map_;
+
+void Recorder::CountInit(int level) { Record(level, kInit); }
+
+void Recorder::CountReset(int level) { Record(level, kReset); }
+
+std::map<int, size_t> Recorder::GetMap(Kind kind) {
+  std::map<int, size_t> res;
+  Visit([&res, kind](Event const& event) {
+    if (event.kind == kind) {
+      res[event.level]++;
+    }
+  });
+  return res;
 }
 
-void Recorder::SetState(std::string const& name, bool val) {
+std::map<int, size_t> Recorder::GetInitMap() { return GetMap(kInit); }
+
+std::map<int, size_t> Recorder::GetResetMap() { return GetMap(kReset); }
+
+std::vector<Recorder::Event> Recorder::GetEvents() {
+  std::vector<Event> res;
+  Visit([&res](Event const& event) { res.push_back(event); });
+  std::stable_sort(res.begin(), res.end(),
+                   [](Event const& a, Event const& b) {
+                     return a.time_ns < b.time_ns;
+                   });
+  return res;
+}
+
+size_t Recorder::GetId(std::string const& name) {
+  Registry& registry = GetRegistry();
+  std::lock_guard<std::mutex> guard(registry.mutex);
+  auto cit = std::find(registry.names.begin(), registry.names.end(), name);
+  if (cit != registry.names.end()) {
+    return static_cast<size_t>(cit - registry.names.begin());
+  }
+
+  assert(registry.names.size() < kMaxComponents);
+  registry.names.push_back(name);
+  return registry.names.size() - 1;
+}
+
+void Recorder::SetState(size_t id, bool val) noexcept {
+  std::atomic<size_t>& state = GetRegistry().states[id];
   if (val) {
-    auto res = state_map_.insert(std::make_pair(name, 1));
-    if (!res.second) {
-      (*res.first).second++;
-    }
-  } else {
-    auto cit = state_map_.find(name);
-    if (cit != state_map_.end() && (*cit).second > 0) {
-      (*cit).second--;
-    }
+    state.fetch_add(1, std::memory_order_relaxed);
+    return;
   }
+
+  size_t cur = state.load(std::memory_order_relaxed);
+  while (cur > 0 && !state.compare_exchange_weak(cur, cur - 1,
+                                                 std::memory_order_relaxed)) {
+  }
+}
+
+size_t Recorder::GetState(size_t id) noexcept {
+  return GetRegistry().states[id].load(std::memory_order_relaxed);
+}
+
+void Recorder::SetState(std::string const& name, bool val) {
+  SetState(GetId(name), val);
 }
 
-size_t Recorder::GetState(std::string const& name) noexcept {
-  auto cit = state_map_.find(name);
-  if (cit == state_map_.end()) {
+size_t Recorder::GetState(std::string const& name) {
+  Registry& registry = GetRegistry();
+  std::lock_guard<std::mutex> guard(registry.mutex);
+  auto cit = std::find(registry.names.begin(), registry.names.end(), name);
+  if (cit == registry.names.end()) {
     return 0;
   }
-  return (*cit).second;
+  return registry.states[cit - registry.names.begin()].load(
+      std::memory_order_relaxed);
+}
+
+std::map<std::string, size_t> Recorder::GetStateMap() {
+  Registry& registry = GetRegistry();
+  std::lock_guard<std::mutex> guard(registry.mutex);
+  std::map<std::string, size_t> res;
+  for (size_t i = 0; i < registry.names.size(); i++) {
+    res[registry.names[i]] = registry.states[i].load(std::memory_order_relaxed);
+  }
+  return res;
+}
+
+void Recorder::Clear() {
+  Registry& registry = GetRegistry();
+  std::lock_guard<std::mutex> guard(registry.mutex);
+  for (auto const& buffer : registry.buffers) {
+    Chunk* cur = buffer->head.next.exchange(nullptr);
+    while (cur) {
+      Chunk* next = cur->next.load(std::memory_order_relaxed);
+      delete cur;
+      cur = next;
+    }
+    buffer->head.count.store(0);
+    buffer->tail = &buffer->head;
+  }
+  for (auto& state : registry.states) {
+    state.store(0);
+  }
 }
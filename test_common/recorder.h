@@ -24,30 +24,60 @@
 #define TEST_COMMON_RECORDER_H_
 
 #include <cstddef>
+#include <cstdint>
 #include <map>
 #include <string>
+#include <vector>
 
+// Thread-safe test recorder
+//
+// Events are appended to per-thread buffers without locking and
+// merged on read, component states are atomic counters indexed
+// by integer component ids. Recording is cheap enough to use it
+// as a benchmark probe.
 class Recorder final {
  public:
+  enum Kind : uint8_t { kInit, kReset };
+
+  struct Event {
+    uint64_t time_ns;  // steady_clock
+    int level;
+    Kind kind;
+  };
+
+  // Max number of component ids
+  static size_t const kMaxComponents = 64;
+
   // Count init and reset events per level
   static void CountInit(int level);
   static void CountReset(int level);
 
   // Get the level -> number-of-events map for inspection
-  static std::map<int, size_t> const& GetInitMap() noexcept;
-  static std::map<int, size_t> const& GetResetMap() noexcept;
+  static std::map<int, size_t> GetInitMap();
+  static std::map<int, size_t> GetResetMap();
+
+  // Get all events ordered by time
+  static std::vector<Event> GetEvents();
+
+  // Get the id of the component, registers the name on the first call
+  static size_t GetId(std::string const& name);
 
   // Set/get state for component
-  static void SetState(std::string const& name, bool);
-  static size_t GetState(std::string const& name) noexcept;
+  static void SetState(size_t id, bool val) noexcept;
+  static size_t GetState(size_t id) noexcept;
+  static void SetState(std::string const& name, bool val);
+  static size_t GetState(std::string const& name);
 
   // Get Map of component states
-  static std::map<std::string, size_t> const& GetStateMap() noexcept;
+  static std::map<std::string, size_t> GetStateMap();
+
+  // Drop events and states, must not run concurrently
+  // with recording
+  static void Clear();
 
  private:
-  static std::map<int, size_t> init_map_;
-  static std::map<int, size_t> reset_map_;
-  static std::map<std::string, size_t> state_map_;
+  static void Record(int level, Kind kind);
+  static std::map<int, size_t> GetMap(Kind kind);
 };
 
 #endif  // TEST_COMMON_RECORDER_H_
@@ -0,0 +1,302 @@
+// Copyright (C) 2020  Aleksey Romanov (aleksey at voltanet dot io)
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+#include <even_tag.h>
+#include <init_chain_multi.h>
+#include <init_chain_tagged.h>
+#include <odd_tag.h>
+#include <recorder.h>
+
+#include <atomic>
+#include <cassert>
+#include <chrono>  // NOLINT we need the standard chrono
+#include <climits>
+#include <iostream>
+#include <string>
+#include <thread>  // NOLINT we need the standard thread
+#include <vector>
+
+// Permissions, separate for each tag
+template <>
+bool simple::InitChain<Even>::AllowReset() {
+  return true;
+}
+
+template <>
+bool simple::InitChain<Odd>::AllowReset() {
+  return true;
+}
+
+// Runs the even chain apart from the multi-chain runner
+class EvenRunner : public simple::InitChain<Even>::Runner {
+ public:
+  bool Run() noexcept { return DoRun(); }
+};
+
+// Waits for the flag set by another chain, gives up after 10s
+static bool WaitFor(std::atomic<bool> const& flag) {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (!flag.load()) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      return false;
+    }
+    std::this_thread::yield();
+  }
+  return true;
+}
+
+int main(int argc, char**) {
+  if (argc != 1) {
+    std::cout << "unexpected parameters\n";
+    return 1;
+  }
+
+  simple::MultiChainRunner runner;
+
+  auto res = runner.AddChain<simple::InitChain<Even>>("even");
+  assert(res);
+  res = runner.AddChain<simple::InitChain<Odd>>("odd");
+  assert(res);
+  res = runner.AddChain<simple::InitChain<Odd>>("odd");
+  assert(!res);
+
+  res = runner.AddBarrier("odd", INT_MIN, "none", INT_MAX);
+  assert(!res);
+  res = runner.AddBarrier("odd", INT_MIN, "odd", INT_MAX);
+  assert(!res);
+
+  // Odd does not start until even is complete
+  res = runner.AddBarrier("odd", INT_MIN, "even", INT_MAX);
+  assert(res);
+
+  assert(Recorder::GetInitMap().size() == 0);
+  assert(Recorder::GetResetMap().size() == 0);
+
+  res = runner.Run();
+  assert(res);
+
+  assert(Recorder::GetState("a") == 1);
+  assert(Recorder::GetState("b") == 1);
+  assert(Recorder::GetState("c") == 1);
+  assert(Recorder::GetState("d") == 1);
+  assert(Recorder::GetState("e") == 2);
+
+  assert(Recorder::GetInitMap().size() == 6);
+  assert(Recorder::GetResetMap().size() == 0);
+
+  // Odd levels (15 and 25) come after all even ones
+  std::vector<Recorder::Event> events = Recorder::GetEvents();
+  assert(events.size() == 6);
+  assert(events[4].level == 15);
+  assert(events[5].level == 25);
+
+  std::vector<std::string> order = runner.GetCompletionOrder();
+  assert(order.size() == 2);
+  assert(order[0] == "even");
+  assert(order[1] == "odd");
+
+  // Resets go in the reverse order: odd, then even
+  res = runner.Reset();
+  assert(res);
+
+  assert(Recorder::GetState("a") == 1);  // Empty reset
+  assert(Recorder::GetState("b") == 0);
+  assert(Recorder::GetState("c") == 1);  // No reset
+  assert(Recorder::GetState("d") == 0);
+  assert(Recorder::GetState("e") == 1);
+
+  assert(Recorder::GetInitMap().size() == 6);
+  assert(Recorder::GetResetMap().size() == 3);
+  assert(runner.GetCompletionOrder().empty());
+
+  // Only odd has links to run
+  res = runner.Run();
+  assert(res);
+
+  assert(Recorder::GetState("a") == 1);
+  assert(Recorder::GetState("b") == 1);
+  assert(Recorder::GetState("c") == 1);
+  assert(Recorder::GetState("d") == 1);
+  assert(Recorder::GetState("e") == 1);
+
+  res = runner.Reset();
+  assert(res);
+
+  {
+    // Chains run concurrently: the link of each chain waits
+    // for the link of the other one to start
+    static std::atomic<bool> even_in(false);
+    static std::atomic<bool> odd_in(false);
+    static bool even_met = false;
+    static bool odd_met = false;
+    simple::InitChain<Even>::Link even_link(30, [] {
+      even_in.store(true);
+      even_met = WaitFor(odd_in);
+      return true;
+    });
+    simple::InitChain<Odd>::Link odd_link(30, [] {
+      odd_in.store(true);
+      odd_met = WaitFor(even_in);
+      return true;
+    });
+
+    simple::MultiChainRunner concurrent;
+    res = concurrent.AddChain<simple::InitChain<Even>>("even");
+    assert(res);
+    res = concurrent.AddChain<simple::InitChain<Odd>>("odd");
+    assert(res);
+
+    res = concurrent.Run();
+    assert(res);
+    assert(even_met);
+    assert(odd_met);
+
+    res = concurrent.Reset();
+    assert(res);
+  }
+
+  {
+    // Odd waits at level 35 for the even links up to 30, its
+    // lower levels go on meanwhile
+    static std::atomic<bool> odd_low(false);
+    static std::atomic<bool> even_done(false);
+    static bool low_met = false;
+    static bool high_after = false;
+    simple::InitChain<Even>::Link even_link(30, [] {
+      low_met = WaitFor(odd_low);
+      even_done.store(true);
+      return true;
+    });
+    simple::InitChain<Odd>::Link odd_low_link(5, [] {
+      odd_low.store(true);
+      return true;
+    });
+    simple::InitChain<Odd>::Link odd_high_link(35, [] {
+      high_after = even_done.load();
+      return true;
+    });
+
+    simple::MultiChainRunner level;
+    res = level.AddChain<simple::InitChain<Even>>("even");
+    assert(res);
+    res = level.AddChain<simple::InitChain<Odd>>("odd");
+    assert(res);
+    res = level.AddBarrier("odd", 35, "even", 30);
+    assert(res);
+
+    res = level.Run();
+    assert(res);
+    assert(low_met);
+    assert(high_after);
+
+    res = level.Reset();
+    assert(res);
+  }
+
+  {
+    // Chains waiting on each other: the barriers are broken,
+    // all links run and the run fails
+    static bool even_ran = false;
+    static bool odd_ran = false;
+    simple::InitChain<Even>::Link even_link(30, [] {
+      even_ran = true;
+      return true;
+    });
+    simple::InitChain<Odd>::Link odd_link(30, [] {
+      odd_ran = true;
+      return true;
+    });
+
+    simple::MultiChainRunner deadlock;
+    res = deadlock.AddChain<simple::InitChain<Even>>("even");
+    assert(res);
+    res = deadlock.AddChain<simple::InitChain<Odd>>("odd");
+    assert(res);
+    res = deadlock.AddBarrier("odd", INT_MIN, "even", INT_MAX);
+    assert(res);
+    res = deadlock.AddBarrier("even", INT_MIN, "odd", INT_MAX);
+    assert(res);
+
+    res = deadlock.Run();
+    assert(!res);
+    assert(even_ran);
+    assert(odd_ran);
+
+    res = deadlock.Reset();
+    assert(res);
+  }
+
+  {
+    // Even fails, its run mutex is held by a run of its own:
+    // odd does not start the links behind the barrier
+    static std::atomic<bool> hold(true);
+    static std::atomic<bool> holding(false);
+    static bool odd_high = false;
+    simple::InitChain<Even>::Link even_link(40, [] {
+      holding.store(true);
+      while (hold.load()) {
+        std::this_thread::yield();
+      }
+      return true;
+    });
+    simple::InitChain<Odd>::Link odd_link(35, [] {
+      odd_high = true;
+      return true;
+    });
+
+    EvenRunner even_runner;
+    std::thread holder([&even_runner] {
+      bool ok = even_runner.Run();
+      assert(ok);
+      (void)ok;
+    });
+    res = WaitFor(holding);
+    assert(res);
+
+    simple::MultiChainRunner failing;
+    res = failing.AddChain<simple::InitChain<Even>>("even");
+    assert(res);
+    res = failing.AddChain<simple::InitChain<Odd>>("odd");
+    assert(res);
+    res = failing.AddBarrier("odd", 35, "even", INT_MAX);
+    assert(res);
+
+    res = failing.Run();
+    assert(!res);
+    assert(!odd_high);
+
+    hold.store(false);
+    holder.join();
+
+    // Odd carries on once even succeeds
+    res = failing.Run();
+    assert(res);
+    assert(odd_high);
+
+    res = failing.Reset();
+    assert(res);
+  }
+
+  res = runner.Release();
+  assert(res);
+
+  return 0;
+}
@@ -0,0 +1,219 @@
+// Copyright (C) 2020  Aleksey Romanov (aleksey at voltanet dot io)
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include <fcntl.h>
+#include <init_chain.h>
+#include <init_chain_shm.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+bool simple::InitChain::AllowReset() { return true; }
+
+class TestRunner : public simple::InitChain::Runner {
+ public:
+  bool Run() noexcept { return DoRun(); }
+  bool Reset() noexcept { return DoReset(); }
+};
+
+using Link = simple::SharedInitLink<simple::InitChain>;
+
+// Expensive table derived from the input
+static std::string input = "input-1";
+static size_t builds;
+static size_t resets;
+static std::string table;
+
+static uint64_t InputChecksum() {
+  return simple::WarmCache::Checksum(input.data(), input.size());
+}
+
+static bool Build(std::vector<char>* out) {
+  builds++;
+  // Slow enough for the processes to meet
+  usleep(50000);
+  std::string res = "table of " + input;
+  out->assign(res.begin(), res.end());
+  return true;
+}
+
+static bool Load(void const* data, size_t size) {
+  table.assign(static_cast<char const*>(data), size);
+  return true;
+}
+
+static bool Reset() {
+  resets++;
+  table.clear();
+  return true;
+}
+
+// Runs the link, returns true if this process built the segment
+static bool Start(std::string const& name, std::string const& lock_path) {
+  TestRunner runner;
+  Link link(10, name, lock_path, &InputChecksum, &Build, &Load, &Reset);
+
+  size_t prev_builds = builds;
+  bool res = runner.Run();
+  assert(res);
+  assert(table == "table of " + input);
+  assert(link.GetSegment().GetSize() == table.size());
+  assert(link.GetSegment().IsBuilt() == (builds != prev_builds));
+  res = runner.Reset();
+  assert(res);
+  assert(link.GetSegment().GetData() == nullptr);
+  (void)res;
+  return builds != prev_builds;
+}
+
+// Starts processes at once, returns the number of builders
+static int StartProcesses(std::string const& name,
+                          std::string const& lock_path, int count) {
+  std::vector<pid_t> pids;
+  for (int i = 0; i < count; i++) {
+    pid_t pid = fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+      _exit(Start(name, lock_path) ? 10 : 0);
+    }
+    pids.push_back(pid);
+  }
+
+  int built = 0;
+  for (pid_t pid : pids) {
+    int status = 0;
+    pid_t res = waitpid(pid, &status, 0);
+    assert(res == pid);
+    assert(WIFEXITED(status));
+    assert(WEXITSTATUS(status) == 0 || WEXITSTATUS(status) == 10);
+    built += WEXITSTATUS(status) == 10;
+    (void)res;
+  }
+  return built;
+}
+
+// Replaces the segment by the bytes, e.g. a leftover of a crash
+static void Overwrite(std::string const& name, std::string const& bytes) {
+  shm_unlink(name.c_str());
+  int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+  assert(fd >= 0);
+  ssize_t res = write(fd, bytes.data(), bytes.size());
+  assert(res == static_cast<ssize_t>(bytes.size()));
+  close(fd);
+  (void)res;
+}
+
+int main(int argc, char**) {
+  if (argc != 1) {
+    std::cout << "unexpected parameters\n";
+    return 1;
+  }
+
+  std::string name = "/test_shm_" + std::to_string(getpid());
+  std::string lock_path = "/tmp" + name + ".lock";
+
+  // Cold start: one of the processes builds, the others map
+  int built = StartProcesses(name, lock_path, 4);
+  assert(built == 1);
+
+  // Warm: nobody builds
+  built = StartProcesses(name, lock_path, 4);
+  assert(built == 0);
+
+  // Reset unmaps, init maps again without a build
+  bool warm = !Start(name, lock_path);
+  assert(warm);
+  {
+    TestRunner runner;
+    Link link(10, name, lock_path, &InputChecksum, &Build, &Load, &Reset);
+    bool res = runner.Run() && runner.Reset() && runner.Run();
+    assert(res);
+    assert(!link.GetSegment().IsBuilt());
+    assert(table == "table of " + input);
+    res = runner.Reset();
+    assert(res);
+    (void)res;
+  }
+  assert(builds == 0);
+  assert(resets == 3);
+
+  // Input changed: rebuilt once
+  input = "input-2";
+  built = StartProcesses(name, lock_path, 4);
+  assert(built == 1);
+  warm = !Start(name, lock_path);
+  assert(warm);
+
+  // Stale segments: garbage, a header only, nothing; rebuilt
+  Overwrite(name, "garbage");
+  warm = !Start(name, lock_path);
+  assert(!warm);
+  Overwrite(name, std::string(64, '\0'));
+  built = StartProcesses(name, lock_path, 4);
+  assert(built == 1);
+  Overwrite(name, "");
+  warm = !Start(name, lock_path);
+  assert(!warm);
+
+  // Corrupted data: trusted by default, rebuilt if verified
+  {
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    assert(fd >= 0);
+    ssize_t res = pwrite(fd, "X", 1, 70);
+    assert(res == 1);
+    close(fd);
+    (void)res;
+  }
+  simple::SharedSegment segment(name, lock_path);
+  bool res = segment.Acquire(InputChecksum(), &Build);
+  assert(res);
+  assert(!segment.IsBuilt());
+  segment.SetVerify(true);
+  res = segment.Acquire(InputChecksum(), &Build);
+  assert(res);
+  assert(segment.IsBuilt());
+  segment.Release();
+  warm = !Start(name, lock_path);
+  assert(warm);
+
+  // Removed: rebuilt
+  res = segment.Remove();
+  assert(res);
+  warm = !Start(name, lock_path);
+  assert(!warm);
+
+  res = segment.Remove();
+  assert(res);
+  unlink(lock_path.c_str());
+  (void)built;
+  (void)warm;
+  (void)res;
+  return 0;
+}
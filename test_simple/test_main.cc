@@ -24,9 +24,19 @@
 #include <getopt.h>
 #include <init_chain.h>
 #include <recorder.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>  // NOLINT we need the standard chrono
+#include <climits>
 #include <iostream>
+#include <mutex>  // NOLINT we need the standard mutex
+#include <stdexcept>
+#include <thread>  // NOLINT we need the standard thread
+#include <vector>
 
 static void usage() {
   std::cout << "usage: test_simple_init_chain [option]\n";
@@ -35,6 +45,19 @@ static void usage() {
   std::cout << " -e,--exception      throw exception from operation\n";
   std::cout << " -r,--release        do release\n";
   std::cout << " -l,--link-release   do release link\n";
+  std::cout << " -x,--fast-exit      do fast exit\n";
+  std::cout << " -p,--partial        do partial runs\n";
+  std::cout << " -b,--background     run late levels in background\n";
+  std::cout << " -c,--cancel         cancel run\n";
+  std::cout << " -F,--fail-fast      stop and unwind on exception\n";
+  std::cout << " -a,--aggregate      collect exceptions\n";
+  std::cout << " -k,--fork           run child links in forked children\n";
+  std::cout << " -t,--thread         run thread links on threads\n";
+  std::cout << " -u,--usage          account resources used by links\n";
+  std::cout << " -w,--parallel       run links of a level in parallel\n";
+  std::cout << " -s,--schedule       repeat cycles from the schedule\n";
+  std::cout << " -H,--histogram      record latency histograms\n";
+  std::cout << " -o,--order          reverse and shuffle levels\n";
 }
 
 // Static permssions
@@ -51,26 +74,90 @@ class TestRunner : public simple::InitChain::Runner {
   TestRunner& operator=(TestRunner&& other) = default;
 
   bool Run() noexcept { return DoRun(); }
+  bool Run(int max_level) noexcept { return DoRun(max_level); }
+  bool Run(simple::InitChain::LevelHook const& hook,
+           simple::InitChain::CancelToken const& token) noexcept {
+    return DoRun(INT_MAX, hook, token);
+  }
   bool Reset() noexcept { return DoReset(); }
   bool Release() noexcept { return DoRelease(); }
   bool Release(simple::InitChain::Link* link) noexcept {
     return DoRelease(link);
   }
+  bool FastExit() noexcept { return DoFastExit(); }
+  bool RunChild() noexcept { return DoRunChild(); }
+  void RunThread() noexcept { DoRunThread(); }
+  void ResetThread() noexcept { DoResetThread(); }
+  void SetBackgroundLevel(int level) noexcept { DoSetBackgroundLevel(level); }
+  bool IsBackgroundDone() noexcept { return DoIsBackgroundDone(); }
+  void WaitBackground() noexcept { DoWaitBackground(); }
+  void SetErrorPolicy(simple::InitChain::ErrorPolicy policy) noexcept {
+    DoSetErrorPolicy(policy);
+  }
+  std::vector<simple::InitChain::Error> GetErrors() { return DoGetErrors(); }
+  bool Check(size_t* init_count, size_t* reset_count) noexcept {
+    return DoCheck(init_count, reset_count);
+  }
+  simple::InitChain::Stats GetStats() noexcept { return DoGetStats(); }
+  simple::InitChain::LinkHistograms GetHistograms(
+      simple::InitChain::Link const& link) noexcept {
+    return DoGetHistograms(link);
+  }
+  simple::InitChain::LinkUsage GetUsage(
+      simple::InitChain::Link const& link) noexcept {
+    return DoGetUsage(link);
+  }
+  std::vector<simple::InitChain::LinkUsage> GetLevelUsage() {
+    return DoGetLevelUsage();
+  }
+  void SetAllocCounter(simple::InitChain::AllocCounter counter) noexcept {
+    DoSetAllocCounter(counter);
+  }
+  void ResetStats() noexcept { DoResetStats(); }
+  void SetParallel(unsigned threads) noexcept { DoSetParallel(threads); }
+  void SetLevelOrder(simple::InitChain::LevelOrder order,
+                     uint64_t seed = 1) noexcept {
+    DoSetLevelOrder(order, seed);
+  }
+  void SetResourceLimit(simple::InitChain::ResourceClass resource,
+                        uint64_t limit) noexcept {
+    DoSetResourceLimit(resource, limit);
+  }
 };
 
 int main(int argc, char** argv) {
   static struct option long_options[] = {
       {"exception", no_argument, 0, 1}, {"failure", no_argument, 0, 2},
       {"help", no_argument, 0, 3},      {"link-release", no_argument, 0, 4},
-      {"release", no_argument, 0, 5},   {0, 0, 0, 0}};
+      {"release", no_argument, 0, 5},   {"fast-exit", no_argument, 0, 6},
+      {"partial", no_argument, 0, 7},   {"background", no_argument, 0, 8},
+      {"cancel", no_argument, 0, 9},    {"fail-fast", no_argument, 0, 10},
+      {"aggregate", no_argument, 0, 11}, {"fork", no_argument, 0, 12},
+      {"thread", no_argument, 0, 13},    {"usage", no_argument, 0, 14},
+      {"parallel", no_argument, 0, 15},  {"schedule", no_argument, 0, 16},
+      {"histogram", no_argument, 0, 17}, {"order", no_argument, 0, 18},
+      {0, 0, 0, 0}};
 
   bool do_failure = false;
   bool do_exception = false;
   bool do_link_release = false;
   bool do_release = false;
+  bool do_fast_exit = false;
+  bool do_partial = false;
+  bool do_background = false;
+  bool do_cancel = false;
+  bool do_fail_fast = false;
+  bool do_aggregate = false;
+  bool do_fork = false;
+  bool do_thread = false;
+  bool do_usage = false;
+  bool do_parallel = false;
+  bool do_schedule = false;
+  bool do_histogram = false;
+  bool do_order = false;
 
   for (;;) {
-    int c = getopt_long(argc, argv, "efhlr", long_options, 0);
+    int c = getopt_long(argc, argv, "abcefhkloprstuwxFH", long_options, 0);
 
     if (c < 0) {
       break;
@@ -124,6 +211,71 @@ int main(int argc, char** argv) {
         do_release = true;
         break;
 
+      case 6:
+      case 'x':
+        do_fast_exit = true;
+        break;
+
+      case 7:
+      case 'p':
+        do_partial = true;
+        break;
+
+      case 8:
+      case 'b':
+        do_background = true;
+        break;
+
+      case 9:
+      case 'c':
+        do_cancel = true;
+        break;
+
+      case 10:
+      case 'F':
+        do_fail_fast = true;
+        break;
+
+      case 11:
+      case 'a':
+        do_aggregate = true;
+        break;
+
+      case 12:
+      case 'k':
+        do_fork = true;
+        break;
+
+      case 13:
+      case 't':
+        do_thread = true;
+        break;
+
+      case 14:
+      case 'u':
+        do_usage = true;
+        break;
+
+      case 15:
+      case 'w':
+        do_parallel = true;
+        break;
+
+      case 16:
+      case 's':
+        do_schedule = true;
+        break;
+
+      case 17:
+      case 'H':
+        do_histogram = true;
+        break;
+
+      case 18:
+      case 'o':
+        do_order = true;
+        break;
+
       default:
         usage();
         return 1;
@@ -159,6 +311,17 @@ int main(int argc, char** argv) {
     assert(Recorder::GetState("d") == 0);  // Exception
     assert(Recorder::GetState("e") == 2);
 
+#ifdef INIT_CHAIN_STATS
+    assert(test_runner.GetStats().inits_thrown == 1);
+#endif
+
+    size_t init_count = 0;
+    size_t reset_count = 0;
+    res = test_runner.Check(&init_count, &reset_count);
+    assert(res);
+    assert(init_count == 0);
+    assert(reset_count > 0);
+
     // In UT environment we can re-run excepted entries
     res = test_runner.Reset();
     assert(res);
@@ -184,6 +347,759 @@ int main(int argc, char** argv) {
     return 0;
   }
 
+  if (do_fail_fast) {
+    test_runner.SetErrorPolicy(simple::InitChain::kErrorFailFast);
+    CompD::ArmException();
+
+    auto res = test_runner.Run();
+    assert(!res);
+
+    // Stopped at d, what was initialized is reset
+    assert(Recorder::GetState("a") == 1);  // No reset
+    assert(Recorder::GetState("b") == 0);
+    assert(Recorder::GetState("c") == 1);  // No reset
+    assert(Recorder::GetState("d") == 0);  // Exception
+    assert(Recorder::GetState("e") == 0);  // Not reached
+    assert(Recorder::GetResetMap().size() == 1);
+
+    size_t init_count = 0;
+    size_t reset_count = 0;
+    res = test_runner.Check(&init_count, &reset_count);
+    assert(res);
+    assert(init_count > 0);
+    assert(reset_count == 0);
+
+    // The failed link is retried
+    res = test_runner.Run();
+    assert(res);
+
+    assert(Recorder::GetState("b") == 1);
+    assert(Recorder::GetState("d") == 1);
+    assert(Recorder::GetState("e") == 2);
+    return 0;
+  }
+
+  if (do_aggregate) {
+    test_runner.SetErrorPolicy(simple::InitChain::kErrorAggregate);
+    CompD::ArmException();
+
+    auto res = test_runner.Run();
+    assert(!res);
+
+    // Everything else is initialized
+    assert(Recorder::GetState("a") == 1);
+    assert(Recorder::GetState("b") == 1);
+    assert(Recorder::GetState("c") == 1);
+    assert(Recorder::GetState("d") == 0);  // Exception
+    assert(Recorder::GetState("e") == 2);
+
+    auto errors = test_runner.GetErrors();
+    assert(errors.size() == 1);
+    assert(errors[0].level == 25);
+
+    bool caught = false;
+    try {
+      std::rethrow_exception(errors[0].error);
+    } catch (std::logic_error const&) {
+      caught = true;
+    }
+    assert(caught);
+
+    // Errors are kept until the next run
+    res = test_runner.Run();
+    assert(res);
+    assert(test_runner.GetErrors().empty());
+    return 0;
+  }
+
+  if (do_fork) {
+    // Per-child state, not initialized in the parent
+    static int child_inits = 0;
+    simple::InitChain::ChildLink* child_link =
+        new simple::InitChain::ChildLink(30, [] {
+          child_inits++;
+          return true;
+        });
+
+    auto res = test_runner.Run();
+    assert(res);
+    assert(child_inits == 0);
+    assert(Recorder::GetState("e") == 2);
+
+    // Not a child
+    res = test_runner.RunChild();
+    assert(!res);
+
+    // Forks race with a thread using the link mutex
+    std::atomic<bool> stop(false);
+    std::thread checker([&stop, &test_runner] {
+      while (!stop.load()) {
+        size_t init_count = 0;
+        size_t reset_count = 0;
+        bool ok = test_runner.Check(&init_count, &reset_count);
+        assert(ok);
+        (void)ok;
+      }
+    });
+
+    for (int idx = 0; idx < 3; idx++) {
+      pid_t pid = fork();
+      assert(pid >= 0);
+
+      if (pid == 0) {
+        // Shared state is inherited, only the child link runs
+        bool ok = test_runner.RunChild();
+        ok = ok && child_inits == 1 && Recorder::GetState("e") == 2;
+        ok = ok && test_runner.RunChild() && child_inits == 1;
+        ok = ok && test_runner.Reset() && child_inits == 1;
+        _exit(ok ? 0 : 1);
+      }
+
+      int status = 0;
+      pid_t done = waitpid(pid, &status, 0);
+      assert(done == pid);
+      assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+      (void)done;
+    }
+
+    stop.store(true);
+    checker.join();
+
+    assert(child_inits == 0);
+    assert(Recorder::GetInitMap().size() == 6);
+
+    size_t init_count = 0;
+    res = test_runner.Check(&init_count, nullptr);
+    assert(res);
+    assert(init_count == 0);
+
+    // A fork does not wait for a run or a thread link function
+    // of another thread, the child abandons them
+    static std::atomic<bool> blocked(false);
+    static std::atomic<bool> unblock(false);
+    simple::InitChain::Link* blocking = new simple::InitChain::Link(
+        40,
+        [] {
+          blocked.store(true);
+          while (!unblock.load()) {
+            std::this_thread::yield();
+          }
+          return true;
+        },
+        [] { return true; });
+    simple::InitChain::ThreadLink* thread_link =
+        new simple::InitChain::ThreadLink(40, [] {
+          blocked.store(true);
+          while (!unblock.load()) {
+            std::this_thread::yield();
+          }
+          return true;
+        });
+
+    for (int idx = 0; idx < 2; idx++) {
+      blocked.store(false);
+      unblock.store(false);
+      std::thread busy([idx, &test_runner] {
+        if (idx == 0) {
+          bool ok = test_runner.Run();
+          assert(ok);
+          (void)ok;
+        } else {
+          test_runner.RunThread();
+        }
+      });
+      while (!blocked.load()) {
+        std::this_thread::yield();
+      }
+
+      pid_t pid = fork();
+      assert(pid >= 0);
+
+      if (pid == 0) {
+        // The links of the abandoned calls can be deleted
+        delete blocking;
+        delete thread_link;
+        bool ok = test_runner.Run() && test_runner.Reset();
+        _exit(ok ? 0 : 1);
+      }
+
+      int status = 0;
+      pid_t done = waitpid(pid, &status, 0);
+      assert(done == pid);
+      assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+      (void)done;
+
+      unblock.store(true);
+      busy.join();
+    }
+    test_runner.ResetThread();
+    delete thread_link;
+    delete blocking;
+
+    // An init function forks, the run goes on in the child
+    static pid_t forked = -1;
+    pid_t const parent = getpid();
+    simple::InitChain::Link* forking = new simple::InitChain::Link(
+        40,
+        [] {
+          forked = fork();
+          return forked >= 0;
+        },
+        [] { return true; });
+
+    res = test_runner.Run();
+    if (getpid() != parent) {
+      bool ok = res && forked == 0 && test_runner.Reset();
+      _exit(ok ? 0 : 1);
+    }
+    assert(res);
+
+    int status = 0;
+    pid_t done = waitpid(forked, &status, 0);
+    assert(done == forked);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    (void)done;
+
+    delete forking;
+    delete child_link;
+    return 0;
+  }
+
+  if (do_thread) {
+    // Per-thread state set up by thread links, the order of
+    // functions is recorded as level * sign
+    static thread_local std::vector<int> calls;
+    static std::atomic<int> live(0);
+
+    simple::InitChain::ThreadLink* links[] = {
+        new simple::InitChain::ThreadLink(
+            20,
+            [] {
+              calls.push_back(20);
+              live++;
+              return true;
+            },
+            [] {
+              calls.push_back(-20);
+              live--;
+              return true;
+            }),
+        new simple::InitChain::ThreadLink(10, [] {
+          calls.push_back(10);
+          return true;
+        })};
+
+    auto res = test_runner.Run();
+    assert(res);
+    assert(calls.empty());
+
+    std::vector<std::thread> threads;
+    for (int idx = 0; idx < 3; idx++) {
+      threads.emplace_back([&test_runner] {
+        test_runner.RunThread();
+        test_runner.RunThread();  // Nop
+        assert(calls.size() == 2 && calls[0] == 10 && calls[1] == 20);
+
+        test_runner.ResetThread();
+        assert(calls.size() == 3 && calls[2] == -20);
+      });
+    }
+
+    for (auto& thread : threads) {
+      thread.join();
+    }
+
+    assert(live == 0);
+    assert(calls.empty());
+
+    // Thread links are not affected by the chain
+    res = test_runner.Reset();
+    assert(res);
+    test_runner.RunThread();
+    assert(calls.size() == 2);
+    assert(live == 1);
+
+    delete links[1];
+    delete links[0];
+
+    // Deleted links are not reset
+    test_runner.ResetThread();
+    assert(calls.size() == 2);
+    res = test_runner.Check(nullptr, nullptr);
+    assert(res);
+
+    // Deleted by its own function, and by the function of
+    // another thread link, on the calling thread
+    static simple::InitChain::ThreadLink* self = nullptr;
+    static simple::InitChain::ThreadLink* other = nullptr;
+    self = new simple::InitChain::ThreadLink(30, [] {
+      calls.push_back(30);
+      delete self;
+      self = nullptr;
+      return true;
+    });
+    simple::InitChain::ThreadLink* deleter =
+        new simple::InitChain::ThreadLink(40, [] {
+          calls.push_back(40);
+          delete other;
+          other = nullptr;
+          return true;
+        });
+    other = new simple::InitChain::ThreadLink(50, [] {
+      calls.push_back(50);
+      return true;
+    });
+
+    calls.clear();
+    test_runner.RunThread();
+    assert(!self && !other);
+    assert(calls.size() == 2 && calls[0] == 30 && calls[1] == 40);
+
+    // A new link, even at the address of a deleted one,
+    // is initialized
+    other = new simple::InitChain::ThreadLink(50, [] {
+      calls.push_back(50);
+      return true;
+    });
+    test_runner.RunThread();
+    assert(calls.size() == 3 && calls[2] == 50);
+    res = test_runner.Check(nullptr, nullptr);
+    assert(res);
+
+    delete other;
+    delete deleter;
+    return 0;
+  }
+
+  if (do_usage) {
+    // Built with INIT_CHAIN_ACCOUNTING, the link allocates and
+    // touches 1M reported by the allocation counter
+    static uint64_t allocated = 0;
+    static std::vector<char> buffer;
+    test_runner.SetAllocCounter([]() -> uint64_t { return allocated; });
+
+    simple::InitChain::Link* link = new simple::InitChain::Link(
+        30,
+        [] {
+          size_t const size = 1 << 20;
+          buffer.assign(size, 1);
+          allocated += size;
+          return true;
+        },
+        [] {
+          std::vector<char>().swap(buffer);
+          return true;
+        });
+
+    auto res = test_runner.Run();
+    assert(res);
+
+#ifdef INIT_CHAIN_ACCOUNTING
+    auto usage = test_runner.GetUsage(*link);
+    assert(usage.level == 30);
+    assert(usage.init.calls == 1);
+    assert(usage.init.heap_bytes == 1 << 20);
+    assert(usage.init.cpu_ns > 0);
+    assert(usage.init.minor_faults > 0);
+    assert(usage.reset.calls == 0);
+#endif
+
+    res = test_runner.Reset();
+    assert(res);
+
+#ifdef INIT_CHAIN_ACCOUNTING
+    usage = test_runner.GetUsage(*link);
+    assert(usage.init.calls == 1);
+    assert(usage.reset.calls == 1);
+    assert(usage.reset.heap_bytes == 0);
+
+    // Deleted links are accounted per level
+    auto levels = test_runner.GetLevelUsage();
+    assert(levels.size() == 7);
+    int prev_level = INT_MIN;
+    for (auto const& level : levels) {
+      assert(level.level > prev_level);
+      prev_level = level.level;
+
+      if (level.level == 30) {
+        assert(level.init.heap_bytes == usage.init.heap_bytes);
+        assert(level.init.cpu_ns == usage.init.cpu_ns);
+      }
+      if (level.level == 41 || level.level == 42) {
+        assert(level.init.calls == 1);
+      }
+    }
+#endif
+
+    delete link;
+    return 0;
+  }
+
+  if (do_parallel) {
+    // Links of level 30 stay a while, the peak load of
+    // every resource class is recorded
+    using simple::InitChain;
+    struct Load {
+      InitChain::ResourceClass resource;
+      uint32_t weight;
+    };
+    static std::mutex mutex;
+    static int running = 0;
+    static int peak = 0;
+    static int done = 0;
+    static int resets = 0;
+    static uint64_t load[InitChain::kResourceCount] = {};
+    static uint64_t peak_load[InitChain::kResourceCount] = {};
+
+    test_runner.SetParallel(4);
+    test_runner.SetResourceLimit(InitChain::kResourceIo, 2);
+    test_runner.SetResourceLimit(InitChain::kResourceMemory, 5);
+
+    Load const loads[] = {
+        {InitChain::kResourceCpu, 1},    {InitChain::kResourceCpu, 1},
+        {InitChain::kResourceIo, 1},     {InitChain::kResourceIo, 1},
+        {InitChain::kResourceIo, 1},     {InitChain::kResourceMemory, 2},
+        {InitChain::kResourceMemory, 2}, {InitChain::kResourceMemory, 3}};
+
+    std::vector<InitChain::Link*> links;
+    for (Load const& cur : loads) {
+      InitChain::Link* link = new InitChain::Link(
+          30,
+          [cur] {
+            {
+              std::lock_guard<std::mutex> guard(mutex);
+              running++;
+              peak = std::max(peak, running);
+              load[cur.resource] += cur.weight;
+              peak_load[cur.resource] =
+                  std::max(peak_load[cur.resource], load[cur.resource]);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            std::lock_guard<std::mutex> guard(mutex);
+            running--;
+            done++;
+            load[cur.resource] -= cur.weight;
+            return true;
+          },
+          [] {
+            resets++;
+            return true;
+          });
+      link->SetResource(cur.resource, cur.weight);
+      links.push_back(link);
+    }
+
+    // Deleted by its own function on a worker
+    static InitChain::Link* self = nullptr;
+    self = new InitChain::Link(30, [] {
+      delete self;
+      self = nullptr;
+      return true;
+    });
+
+    // Next level waits for the parallel one
+    links.push_back(new InitChain::Link(40, [] {
+      std::lock_guard<std::mutex> guard(mutex);
+      assert(running == 0 && done == 8);
+      return true;
+    }));
+
+    auto res = test_runner.Run();
+    assert(res);
+    assert(!self);
+    assert(done == 8);
+    assert(peak > 1);
+    assert(peak_load[InitChain::kResourceIo] <= 2);
+    assert(peak_load[InitChain::kResourceMemory] <= 5);
+#ifdef INIT_CHAIN_STATS
+    assert(test_runner.GetStats().levels_parallel >= 1);
+#endif
+
+    res = test_runner.Check(nullptr, nullptr);
+    assert(res);
+
+    // Again, from the reset links
+    res = test_runner.Reset();
+    assert(res);
+    assert(resets == 8);
+    done = 0;
+    res = test_runner.Run();
+    assert(res);
+    assert(done == 8);
+    res = test_runner.Check(nullptr, nullptr);
+    assert(res);
+
+    for (auto link : links) {
+      delete link;
+    }
+    return 0;
+  }
+
+  if (do_order) {
+    // Links of level 50 record the order of inits
+    using simple::InitChain;
+    static std::vector<int> inits;
+
+    std::vector<InitChain::Link*> links;
+    for (int idx = 0; idx < 5; idx++) {
+      links.push_back(new InitChain::Link(
+          50,
+          [idx] {
+            inits.push_back(idx);
+            return true;
+          },
+          [] { return true; }));
+    }
+
+    auto cycle = [&test_runner]() {
+      inits.clear();
+      auto res = test_runner.Reset();
+      assert(res);
+      res = test_runner.Run();
+      assert(res);
+      res = test_runner.Check(nullptr, nullptr);
+      assert(res);
+      return inits;
+    };
+
+    std::vector<int> const order = {0, 1, 2, 3, 4};
+    std::vector<int> const reverse = {4, 3, 2, 1, 0};
+
+    auto res = test_runner.Run();
+    assert(res);
+    assert(inits == order);
+
+    test_runner.SetLevelOrder(InitChain::kOrderReverse);
+    assert(cycle() == reverse);
+    assert(cycle() == reverse);
+
+    // Same seed, same orders
+    std::vector<std::vector<int>> shuffled;
+    test_runner.SetLevelOrder(InitChain::kOrderShuffle, 7);
+    for (int idx = 0; idx < 4; idx++) {
+      shuffled.push_back(cycle());
+      std::vector<int> sorted = shuffled.back();
+      std::sort(sorted.begin(), sorted.end());
+      assert(sorted == order);
+    }
+    assert(std::count(shuffled.begin(), shuffled.end(), order) < 4);
+
+    test_runner.SetLevelOrder(InitChain::kOrderShuffle, 7);
+    for (auto const& cur : shuffled) {
+      assert(cycle() == cur);
+    }
+
+    // New link goes by its registration
+    links.push_back(new InitChain::Link(
+        50,
+        [] {
+          inits.push_back(5);
+          return true;
+        },
+        [] { return true; }));
+    test_runner.SetLevelOrder(InitChain::kOrderReverse);
+    assert(cycle() == std::vector<int>({5, 4, 3, 2, 1, 0}));
+
+    test_runner.SetLevelOrder(InitChain::kOrderRegistration);
+    assert(cycle() == std::vector<int>({0, 1, 2, 3, 4, 5}));
+    assert(cycle() == std::vector<int>({0, 1, 2, 3, 4, 5}));
+
+    for (auto link : links) {
+      delete link;
+    }
+    return 0;
+  }
+
+  if (do_histogram) {
+    // Built with INIT_CHAIN_HISTOGRAMS, init takes at least 1ms
+    using simple::LatencyHistogram;
+    for (unsigned idx = 0; idx < LatencyHistogram::kBuckets; idx++) {
+      assert(LatencyHistogram::GetIndex(LatencyHistogram::GetLower(idx)) ==
+             idx);
+      assert(LatencyHistogram::GetIndex(LatencyHistogram::GetUpper(idx)) ==
+             idx);
+    }
+
+    simple::InitChain::Link* link = new simple::InitChain::Link(
+        30,
+        [] {
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+          return true;
+        },
+        [] { return true; });
+
+    for (int cycle = 0; cycle < 5; cycle++) {
+      auto res = test_runner.Run();
+      assert(res);
+      res = test_runner.Reset();
+      assert(res);
+    }
+
+#ifdef INIT_CHAIN_HISTOGRAMS
+    simple::InitChain::LinkHistograms hist = test_runner.GetHistograms(*link);
+    assert(hist.level == 30);
+    assert(hist.init.GetCount() == 5);
+    assert(hist.reset.GetCount() == 5);
+    assert(hist.init.GetMin() >= 1000000);
+    assert(hist.init.GetPercentile(50) >= 1000000);
+    assert(hist.init.GetPercentile(99) <= hist.init.GetMax());
+    assert(hist.reset.GetMax() < hist.init.GetMin());
+
+    // Merged from the dumps of two processes
+    std::string dump = hist.init.Dump();
+    LatencyHistogram merged;
+    auto res = merged.Merge(dump.data(), dump.size());
+    assert(res);
+    res = merged.Merge(dump.data(), dump.size());
+    assert(res);
+    assert(merged.GetCount() == 10);
+    assert(merged.GetMin() == hist.init.GetMin());
+    assert(merged.GetMax() == hist.init.GetMax());
+    assert(merged.GetPercentile(50) == hist.init.GetPercentile(50));
+
+    // Truncated dump adds nothing
+    res = merged.Merge(dump.data(), dump.size() - 1);
+    assert(!res);
+    assert(merged.GetCount() == 10);
+#endif
+
+    delete link;
+    return 0;
+  }
+
+  if (do_schedule) {
+    // Links of the same level keep the order of registration
+    // in every cycle, the inits are recorded
+    using simple::InitChain;
+    static std::vector<int> inits;
+    static std::vector<int> resets;
+    static InitChain::Link* late = nullptr;
+    static bool add_late = false;
+
+    std::vector<InitChain::Link*> links;
+    for (int idx = 0; idx < 6; idx++) {
+      links.push_back(new InitChain::Link(
+          100 + idx / 3,
+          [idx] {
+            inits.push_back(idx);
+            if (idx == 4 && add_late) {
+              // Registered in the middle of the cycle
+              add_late = false;
+              late = new InitChain::Link(101, [] {
+                inits.push_back(6);
+                return true;
+              }, [] {
+                resets.push_back(6);
+                return true;
+              });
+            }
+            return true;
+          },
+          [idx] {
+            resets.push_back(idx);
+            return true;
+          }));
+    }
+
+    std::vector<int> const order = {0, 1, 2, 3, 4, 5};
+    std::vector<int> const reverse = {5, 4, 3, 2, 1, 0};
+
+    auto res = test_runner.Run();
+    assert(res);
+    assert(inits == order);
+
+    for (int cycle = 0; cycle < 4; cycle++) {
+      inits.clear();
+      resets.clear();
+      res = test_runner.Reset();
+      assert(res);
+      res = test_runner.Run();
+      assert(res);
+      assert(resets == reverse);
+      assert(inits == order);
+      res = test_runner.Check(nullptr, nullptr);
+      assert(res);
+    }
+#ifdef INIT_CHAIN_STATS
+    assert(test_runner.GetStats().schedule_cycles >= 8);
+#endif
+
+    // Deleted link is skipped
+    delete links[1];
+    links[1] = nullptr;
+    inits.clear();
+    resets.clear();
+    res = test_runner.Reset();
+    assert(res);
+    res = test_runner.Run();
+    assert(res);
+    assert(resets == std::vector<int>({5, 4, 3, 2, 0}));
+    assert(inits == std::vector<int>({0, 2, 3, 4, 5}));
+
+    // New link goes after the links of its level, the
+    // schedule is left midway
+#ifdef INIT_CHAIN_STATS
+    uint64_t unwinds = test_runner.GetStats().schedule_unwinds;
+#endif
+    add_late = true;
+    inits.clear();
+    res = test_runner.Reset();
+    assert(res);
+    res = test_runner.Run();
+    assert(res);
+    assert(late);
+    assert(inits == std::vector<int>({0, 2, 3, 4, 5, 6}));
+#ifdef INIT_CHAIN_STATS
+    assert(test_runner.GetStats().schedule_unwinds == unwinds + 1);
+#endif
+
+    // And is in the next schedule
+#ifdef INIT_CHAIN_STATS
+    uint64_t cycles = test_runner.GetStats().schedule_cycles;
+#endif
+    inits.clear();
+    resets.clear();
+    res = test_runner.Reset();
+    assert(res);
+    res = test_runner.Run();
+    assert(res);
+    assert(resets == std::vector<int>({6, 5, 4, 3, 2, 0}));
+    assert(inits == std::vector<int>({0, 2, 3, 4, 5, 6}));
+#ifdef INIT_CHAIN_STATS
+    assert(test_runner.GetStats().schedule_cycles == cycles + 2);
+#endif
+    res = test_runner.Check(nullptr, nullptr);
+    assert(res);
+
+    // A hooked run records no schedule, only the first reset
+    // is taken from it
+#ifdef INIT_CHAIN_STATS
+    cycles = test_runner.GetStats().schedule_cycles;
+#endif
+    simple::InitChain::CancelToken token;
+    res = test_runner.Reset();
+    assert(res);
+    res = test_runner.Run([](int) {}, token);
+    assert(res);
+    res = test_runner.Reset();
+    assert(res);
+    inits.clear();
+    res = test_runner.Run();
+    assert(res);
+    assert(inits == std::vector<int>({0, 2, 3, 4, 5, 6}));
+#ifdef INIT_CHAIN_STATS
+    assert(test_runner.GetStats().schedule_cycles == cycles + 1);
+#endif
+    res = test_runner.Check(nullptr, nullptr);
+    assert(res);
+
+    delete late;
+    for (auto link : links) {
+      delete link;
+    }
+    return 0;
+  }
+
   if (do_failure) {
     CompD::ArmFailure();
     auto res = test_runner.Run();
@@ -241,6 +1157,190 @@ int main(int argc, char** argv) {
     return 0;
   }
 
+  if (do_fast_exit) {
+    auto res = test_runner.Run();
+    assert(res);
+
+    assert(Recorder::GetState("b") == 1);
+    assert(Recorder::GetState("d") == 1);
+    assert(Recorder::GetState("e") == 2);
+
+    res = test_runner.FastExit();
+    assert(res);
+
+    // Only component d asked for the reset at exit
+    assert(Recorder::GetState("a") == 1);
+    assert(Recorder::GetState("b") == 1);
+    assert(Recorder::GetState("c") == 1);
+    assert(Recorder::GetState("d") == 0);
+    assert(Recorder::GetState("e") == 2);
+
+    assert(Recorder::GetResetMap().size() == 1);
+    assert(Recorder::GetResetMap().count(25) == 1);
+
+    // Nothing to run any more
+    res = test_runner.Run();
+    assert(res);
+    assert(Recorder::GetInitMap().size() == 6);
+
+    // Destructors of static links are no-ops from now on
+    return 0;
+  }
+
+  if (do_partial) {
+    auto res = test_runner.Run(20);
+    assert(res);
+
+    assert(Recorder::GetState("a") == 1);
+    assert(Recorder::GetState("b") == 1);
+    assert(Recorder::GetState("c") == 1);
+    assert(Recorder::GetState("d") == 0);
+    assert(Recorder::GetState("e") == 0);
+
+    // Repeated partial runs are nops
+    res = test_runner.Run(20);
+    assert(res);
+    res = test_runner.Run(-100);
+    assert(res);
+    assert(Recorder::GetInitMap().size() == 3);
+#ifdef INIT_CHAIN_STATS
+    assert(test_runner.GetStats().inits_run == 3);
+#endif
+
+    res = test_runner.Run(25);
+    assert(res);
+    assert(Recorder::GetState("d") == 1);
+    assert(Recorder::GetState("e") == 0);
+
+    res = test_runner.Run();
+    assert(res);
+    assert(Recorder::GetState("e") == 2);
+    assert(Recorder::GetInitMap().size() == 6);
+
+    // Resets go in the reverse order of levels
+    res = test_runner.Reset();
+    assert(res);
+    assert(Recorder::GetResetMap().size() == 3);
+
+    int prev_level = INT_MAX;
+    for (auto const& event : Recorder::GetEvents()) {
+      if (event.kind == Recorder::kReset) {
+        assert(event.level <= prev_level);
+        prev_level = event.level;
+      }
+    }
+    return 0;
+  }
+
+  if (do_background) {
+    test_runner.SetBackgroundLevel(25);
+
+    // Returns after the foreground levels
+    auto res = test_runner.Run();
+    assert(res);
+    assert(Recorder::GetState("a") == 1);
+    assert(Recorder::GetState("b") == 1);
+    assert(Recorder::GetState("c") == 1);
+
+    test_runner.WaitBackground();
+    assert(test_runner.IsBackgroundDone());
+    assert(Recorder::GetState("d") == 1);
+    assert(Recorder::GetState("e") == 2);
+    assert(Recorder::GetInitMap().size() == 6);
+
+    res = test_runner.Reset();
+    assert(res);
+    assert(Recorder::GetState("b") == 0);
+    assert(Recorder::GetState("d") == 0);
+
+    // Reset cancels the background thread, whatever it
+    // has initialized is reset
+    res = test_runner.Run();
+    assert(res);
+    res = test_runner.Reset();
+    assert(res);
+    assert(test_runner.IsBackgroundDone());
+    assert(Recorder::GetState("b") == 0);
+    assert(Recorder::GetState("d") == 0);
+
+    size_t init_count = 0;
+    size_t reset_count = 0;
+    res = test_runner.Check(&init_count, &reset_count);
+    assert(res);
+    assert(reset_count == 0);
+
+    // The rest runs in the background again
+    res = test_runner.Run();
+    assert(res);
+    test_runner.WaitBackground();
+    assert(Recorder::GetState("b") == 1);
+    assert(Recorder::GetState("d") == 1);
+
+    // Reset called by an init function, while the background
+    // thread of the previous Run() waits for the run mutex,
+    // fails instead of waiting for the thread
+    static TestRunner* runner = &test_runner;
+    static int nested = 0;
+    res = test_runner.Reset();
+    assert(res);
+    res = test_runner.Run();
+    assert(res);
+    simple::InitChain::Link link(10, [] {
+      nested = runner->Reset() ? 1 : -1;
+      return true;
+    });
+    while (!test_runner.Run()) {
+      // The background thread got the mutex first
+      std::this_thread::yield();
+    }
+    assert(nested == -1);
+    test_runner.WaitBackground();
+    assert(Recorder::GetState("d") == 1);
+    return 0;
+  }
+
+  if (do_cancel) {
+    // Cancelled before level 25, as if by a signal
+    simple::InitChain::CancelToken token;
+    auto hook = [&token](int level) {
+      assert(!simple::InitChain::RunCancelled());
+      if (level == 25) {
+        token.Cancel();
+        assert(simple::InitChain::RunCancelled());
+      }
+    };
+
+    auto res = test_runner.Run(hook, token);
+    assert(res);
+    assert(!simple::InitChain::RunCancelled());
+
+    assert(Recorder::GetState("a") == 1);
+    assert(Recorder::GetState("b") == 1);
+    assert(Recorder::GetState("c") == 1);
+    assert(Recorder::GetState("d") == 0);
+    assert(Recorder::GetState("e") == 0);
+    assert(Recorder::GetInitMap().size() == 3);
+
+    // Only initialized links are reset
+    res = test_runner.Reset();
+    assert(res);
+    assert(Recorder::GetState("b") == 0);
+    assert(Recorder::GetResetMap().size() == 1);
+
+    // Cancelled token stops a run right away
+    res = test_runner.Run(hook, token);
+    assert(res);
+    assert(Recorder::GetState("b") == 0);
+
+    token.Clear();
+    res = test_runner.Run();
+    assert(res);
+    assert(Recorder::GetState("b") == 1);
+    assert(Recorder::GetState("d") == 1);
+    assert(Recorder::GetState("e") == 2);
+    return 0;
+  }
+
   if (do_release) {
     auto res = test_runner.Release();
     assert(res);
@@ -271,6 +1371,20 @@ int main(int argc, char** argv) {
   assert(Recorder::GetInitMap().size() == 6);
   assert(Recorder::GetResetMap().size() == 0);
 
+#ifdef INIT_CHAIN_STATS
+  {
+    auto stats = test_runner.GetStats();
+    assert(stats.links_registered == 6);
+    assert(stats.links_unregistered == 1);  // Deleted itself in init
+    assert(stats.links_deleted_in_callback == 1);
+    assert(stats.inits_run == 6);
+    assert(stats.inits_thrown == 0);
+    assert(stats.resets_run == 0);
+    assert(stats.run_lock_failures == 0);
+    assert(stats.insert_walk_max <= stats.insert_walk_total);
+  }
+#endif
+
   // Duplicate calls are nops
   //
   res = test_runner.Run();
@@ -306,6 +1420,23 @@ int main(int argc, char** argv) {
   assert(Recorder::GetInitMap().size() == 6);
   assert(Recorder::GetResetMap().size() == 3);
 
+#ifdef INIT_CHAIN_STATS
+  {
+    auto stats = test_runner.GetStats();
+    assert(stats.links_unregistered == 2);  // Deleted itself in reset
+    assert(stats.links_deleted_in_callback == 2);
+    assert(stats.inits_run == 8);
+    assert(stats.resets_run == 3);
+    assert(stats.resets_thrown == 0);
+
+    test_runner.ResetStats();
+    stats = test_runner.GetStats();
+    assert(stats.links_registered == 0);
+    assert(stats.inits_run == 0);
+    assert(stats.resets_run == 0);
+  }
+#endif
+
   {
     auto const& init_map = Recorder::GetInitMap();
 
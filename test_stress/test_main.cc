@@ -0,0 +1,388 @@
+// Copyright (C) 2020  Aleksey Romanov (aleksey at voltanet dot io)
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+// Randomized concurrent stress of the chain core
+//
+// Worker threads randomly create, delete and release links, and
+// try Run/Reset/Check, while the main thread alternates Run and
+// Reset. Init and reset functions randomly delete themselves,
+// delete other links and create new ones. Links are owned
+// through a table of slots, a thread takes the ownership of a
+// link by exchanging its slot with null.
+//
+// The lists are checked on the fly, at the end the chain is
+// quiesced and call counts of every link are verified.
+//
+// Build with "make test_stress_tsan" or "make test_stress_asan"
+// to run under sanitizers.
+//
+#include <getopt.h>
+#include <init_chain.h>
+
+#include <atomic>
+#include <cassert>
+#include <chrono>  // NOLINT
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <thread>  // NOLINT
+#include <vector>
+
+bool simple::InitChain::AllowReset() { return true; }
+
+class StressRunner : public simple::InitChain::Runner {
+ public:
+  bool Run() noexcept { return DoRun(); }
+  bool Reset() noexcept { return DoReset(); }
+  bool Release() noexcept { return DoRelease(); }
+  bool Release(simple::InitChain::Link* link) noexcept {
+    return DoRelease(link);
+  }
+  bool Check(size_t* init_count = nullptr,
+             size_t* reset_count = nullptr) noexcept {
+    return DoCheck(init_count, reset_count);
+  }
+};
+
+static size_t const kSlots = 256;
+static int const kLevels = 16;
+
+// Operation counters
+enum Op {
+  kCreate,
+  kDelete,
+  kReleaseLink,
+  kRun,
+  kReset,
+  kLockFailure,
+  kCheck,
+  kCallbackCreate,
+  kCallbackDelete,
+  kCallbackDeleteSelf,
+  kOpCount
+};
+
+static char const* const kOpNames[kOpCount] = {
+    "create",          "delete",          "release-link",
+    "run",             "reset",           "run-lock-failure",
+    "check",           "callback-create", "callback-delete",
+    "callback-delete-self"};
+
+static std::atomic<uint64_t> ops[kOpCount];
+
+static void CountOp(Op op) { ops[op].fetch_add(1, std::memory_order_relaxed); }
+
+// Random actions inside init/reset functions
+static std::atomic<bool> chaos(true);
+
+static thread_local uint64_t rng_state;
+
+static uint64_t Random() {
+  // xorshift64
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 7;
+  rng_state ^= rng_state << 17;
+  return rng_state;
+}
+
+static void Seed(uint64_t seed) {
+  rng_state = seed * 0x9e3779b97f4a7c15ULL + 1;
+}
+
+class Node;
+static std::atomic<Node*> slots[kSlots];
+
+static void Create();
+
+// Node state and functions are in a base preceding Link: it is
+// constructed before the link is registered and destroyed after
+// it is unregistered, so a chain running on another thread never
+// sees it half-built
+class NodeState {
+ public:
+  NodeState(Node* node, size_t slot) noexcept
+      : node_(node), slot_(slot), inits_(), resets_() {}
+
+  uint64_t GetInits() const noexcept { return inits_.load(); }
+  uint64_t GetResets() const noexcept { return resets_.load(); }
+
+ protected:
+  std::function<bool()> InitFunc() {
+    return [this]() {
+      inits_++;
+      return Act();
+    };
+  }
+
+  std::function<bool()> ResetFunc() {
+    return [this]() {
+      resets_++;
+      return Act();
+    };
+  }
+
+ private:
+  // Returns: false if the node was deleted
+  bool Act();
+
+  Node* node_;
+  size_t slot_;
+  std::atomic<uint64_t> inits_;
+  std::atomic<uint64_t> resets_;
+};
+
+class Node final : public NodeState, public simple::InitChain::Link {
+ public:
+  Node(int level, size_t slot) noexcept
+      : NodeState(this, slot), Link(level, InitFunc(), ResetFunc()) {}
+};
+
+// Takes the ownership of the node in the slot
+static Node* Take(size_t slot) {
+  return slots[slot].exchange(nullptr, std::memory_order_acq_rel);
+}
+
+// Gives the node back, deletes it if the slot is taken
+static void Put(size_t slot, Node* node) {
+  Node* expected = nullptr;
+  if (!slots[slot].compare_exchange_strong(expected, node,
+                                           std::memory_order_acq_rel)) {
+    delete node;
+  }
+}
+
+static void Create() {
+  size_t slot = Random() % kSlots;
+  if (slots[slot].load(std::memory_order_relaxed)) {
+    return;
+  }
+  Put(slot, new Node(static_cast<int>(Random() % kLevels), slot));
+}
+
+bool NodeState::Act() {
+  if (!chaos.load(std::memory_order_relaxed)) {
+    return true;
+  }
+
+  uint64_t r = Random() % 100;
+  if (r < 3) {
+    Node* self = node_;
+    if (slots[slot_].compare_exchange_strong(self, nullptr)) {
+      CountOp(kCallbackDeleteSelf);
+      delete node_;
+      return false;
+    }
+  } else if (r < 8) {
+    size_t slot = Random() % kSlots;
+    if (slot != slot_) {
+      Node* node = Take(slot);
+      if (node) {
+        CountOp(kCallbackDelete);
+        delete node;
+      }
+    }
+  } else if (r < 13) {
+    CountOp(kCallbackCreate);
+    Create();
+  }
+  return true;
+}
+
+static std::atomic<bool> stop;
+
+static void Worker(uint64_t seed) {
+  Seed(seed);
+  StressRunner runner;
+
+  while (!stop.load(std::memory_order_relaxed)) {
+    uint64_t r = Random() % 100;
+    if (r < 35) {
+      CountOp(kCreate);
+      Create();
+    } else if (r < 65) {
+      Node* node = Take(Random() % kSlots);
+      if (node) {
+        CountOp(kDelete);
+        delete node;
+      }
+    } else if (r < 80) {
+      size_t slot = Random() % kSlots;
+      Node* node = Take(slot);
+      if (node) {
+        if (runner.Release(node)) {
+          CountOp(kReleaseLink);
+        } else {
+          CountOp(kLockFailure);
+        }
+        Put(slot, node);
+      }
+    } else if (r < 88) {
+      CountOp(runner.Run() ? kRun : kLockFailure);
+    } else if (r < 96) {
+      CountOp(runner.Reset() ? kReset : kLockFailure);
+    } else {
+      CountOp(kCheck);
+      bool res = runner.Check();
+      assert(res);
+      (void)res;
+    }
+  }
+}
+
+static void Usage() {
+  std::cout << "usage: test_stress_init_chain [option]\n";
+  std::cout << "where option could be:\n";
+  std::cout << "    -d, --duration ms  stress duration, default 1000\n";
+  std::cout << "    -h, --help         print this message\n";
+  std::cout << "    -s, --seed seed    random seed, default 1\n";
+  std::cout << "    -t, --threads n    worker threads, default 4\n";
+}
+
+int main(int argc, char** argv) {
+  uint64_t duration_ms = 1000;
+  uint64_t seed = 1;
+  size_t threads = 4;
+
+  static struct option long_options[] = {
+      {"duration", required_argument, 0, 'd'},
+      {"help", no_argument, 0, 'h'},
+      {"seed", required_argument, 0, 's'},
+      {"threads", required_argument, 0, 't'},
+      {0, 0, 0, 0}};
+
+  for (;;) {
+    int c = getopt_long(argc, argv, "d:hs:t:", long_options, 0);
+    if (c == -1) {
+      break;
+    }
+
+    switch (c) {
+      case 'd':
+        duration_ms = std::strtoull(optarg, nullptr, 0);
+        break;
+      case 's':
+        seed = std::strtoull(optarg, nullptr, 0);
+        break;
+      case 't':
+        threads = std::strtoul(optarg, nullptr, 0);
+        break;
+      case 'h':
+      default:
+        Usage();
+        return 1;
+    }
+  }
+
+  Seed(seed);
+  for (size_t i = 0; i < kSlots / 2; i++) {
+    Create();
+  }
+
+  StressRunner runner;
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < threads; i++) {
+    workers.emplace_back(Worker, seed + i + 1);
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  auto end = start + std::chrono::milliseconds(duration_ms);
+  bool run = true;
+  while (std::chrono::steady_clock::now() < end) {
+    if (run) {
+      CountOp(runner.Run() ? kRun : kLockFailure);
+    } else {
+      CountOp(runner.Reset() ? kReset : kLockFailure);
+    }
+    run = !run;
+
+    bool res = runner.Check();
+    assert(res);
+    (void)res;
+  }
+
+  stop = true;
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+
+  // Quiesced: every link in the init list is reset as many
+  // times as initialized, then every link is initialized
+  // once more
+  chaos = false;
+  bool res = runner.Reset();
+  assert(res);
+
+  size_t init_count = 0;
+  size_t reset_count = 0;
+  res = runner.Check(&init_count, &reset_count);
+  assert(res);
+  assert(reset_count == 0);
+
+  size_t in_list = 0;
+  for (auto& slot : slots) {
+    Node* node = slot.load();
+    if (node && node->IsInList()) {
+      in_list++;
+      assert(node->GetInits() == node->GetResets());
+    }
+  }
+  assert(in_list == init_count);
+
+  res = runner.Run();
+  assert(res);
+  res = runner.Check(&init_count, &reset_count);
+  assert(res);
+  assert(init_count == 0);
+  assert(reset_count == in_list);
+
+  for (auto& slot : slots) {
+    Node* node = slot.load();
+    if (node && node->IsInList()) {
+      assert(node->GetInits() == node->GetResets() + 1);
+    }
+  }
+
+  res = runner.Release();
+  assert(res);
+  res = runner.Check(&init_count, &reset_count);
+  assert(res && init_count == 0 && reset_count == 0);
+
+  for (auto& slot : slots) {
+    delete slot.exchange(nullptr);
+  }
+
+  std::cout << "threads=" << threads << " seconds=" << std::fixed
+            << std::setprecision(2) << seconds << "\n";
+  for (size_t i = 0; i < kOpCount; i++) {
+    uint64_t count = ops[i].load();
+    std::cout << "    " << std::left << std::setw(22) << kOpNames[i]
+              << std::right << std::setw(10) << count << std::setw(12)
+              << std::setprecision(0) << count / seconds << " ops/s\n";
+  }
+  (void)res;
+  return 0;
+}
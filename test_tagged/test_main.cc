@@ -25,8 +25,15 @@
 #include <odd_tag.h>
 #include <recorder.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>  // NOLINT we need the standard chrono
+#include <functional>
 #include <iostream>
+#include <mutex>  // NOLINT we need the standard mutex
+#include <thread>  // NOLINT we need the standard thread
+#include <vector>
 
 // Permissions, separate for each tag
 template <>
@@ -39,6 +46,132 @@ bool simple::InitChain<Odd>::AllowReset() {
   return true;
 }
 
+// Chains of parallel levels: the default inline executor and
+// an executor counting the workers it starts
+struct Inline {};
+struct Pooled {};
+
+class CountingExecutor {
+ public:
+  bool Submit(std::function<void()> task) noexcept {
+    submitted++;
+    return executor.Submit(task);
+  }
+
+  std::atomic<int> submitted{0};
+  simple::ThreadExecutor executor;
+};
+
+using InlineChain = simple::InitChain<Inline>;
+using PooledChain =
+    simple::InitChain<Pooled, std::mutex, std::mutex, CountingExecutor>;
+
+template <>
+bool InlineChain::AllowReset() {
+  return true;
+}
+
+template <>
+bool PooledChain::AllowReset() {
+  return true;
+}
+
+// Chain of a production build: resets are not allowed, links
+// reset at exit are still reset on the fast exit
+struct Exiting {};
+using ExitingChain = simple::InitChain<Exiting>;
+
+template <>
+bool ExitingChain::AllowReset() {
+  return false;
+}
+
+class ExitingRunner : public ExitingChain::Runner {
+ public:
+  bool Run() noexcept { return DoRun(); }
+  bool Reset() noexcept { return DoReset(); }
+  bool FastExit() noexcept { return DoFastExit(); }
+};
+
+// Chain counting the acquisitions of its link mutex
+class CountingMutex {
+ public:
+  void lock() {
+    locks++;
+    mutex_.lock();
+  }
+  bool try_lock() {
+    bool res = mutex_.try_lock();
+    locks += res;
+    return res;
+  }
+  void unlock() { mutex_.unlock(); }
+
+  static std::atomic<int> locks;
+
+ private:
+  std::mutex mutex_;
+};
+
+std::atomic<int> CountingMutex::locks{0};
+
+struct Counted {};
+using CountedChain = simple::InitChain<Counted, std::mutex, CountingMutex>;
+
+template <>
+bool CountedChain::AllowReset() {
+  return true;
+}
+
+class CountedRunner : public CountedChain::Runner {
+ public:
+  bool Run() noexcept { return DoRun(); }
+};
+
+template <typename CHAIN>
+class ParallelRunner : public CHAIN::Runner {
+ public:
+  bool Run() noexcept { return this->DoRun(); }
+  bool Reset() noexcept { return this->DoReset(); }
+  void SetParallel(unsigned threads) noexcept { this->DoSetParallel(threads); }
+  void SetExecutor(typename CHAIN::Executor* executor) noexcept {
+    this->DoSetExecutor(executor);
+  }
+};
+
+// Runs four links of a level with four workers, returns the
+// number of distinct threads they ran on
+template <typename CHAIN>
+static size_t RunLevel(ParallelRunner<CHAIN>* runner) {
+  static std::vector<std::thread::id> ids;
+  ids.clear();
+  runner->SetParallel(4);
+
+  std::vector<typename CHAIN::Link*> links;
+  for (int idx = 0; idx < 4; idx++) {
+    links.push_back(new typename CHAIN::Link(10, [] {
+      // Give other workers a chance to start
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      static std::mutex mutex;
+      std::lock_guard<std::mutex> guard(mutex);
+      if (std::find(ids.begin(), ids.end(), std::this_thread::get_id()) ==
+          ids.end()) {
+        ids.push_back(std::this_thread::get_id());
+      }
+      return true;
+    }));
+  }
+
+  bool res = runner->Run() && runner->Reset();
+  assert(res);
+  (void)res;
+
+  for (auto link : links) {
+    delete link;
+  }
+  return ids.size();
+}
+
 // Runner classes
 class EvenTestRunner : public simple::InitChain<Even>::Runner {
  public:
@@ -217,5 +350,66 @@ int main(int argc, char**) {
     }
   }
 
+  // Inline executor: links of a parallel level run on the
+  // calling thread
+  ParallelRunner<InlineChain> inline_runner;
+  size_t threads = RunLevel(&inline_runner);
+  assert(threads == 1);
+
+  // Plugged executor: three workers are submitted, the calling
+  // thread is the fourth
+  CountingExecutor executor;
+  ParallelRunner<PooledChain> pooled_runner;
+  pooled_runner.SetExecutor(&executor);
+  threads = RunLevel(&pooled_runner);
+  assert(threads > 1);
+  assert(executor.submitted == 3);
+  (void)threads;
+
+  // Resets not allowed: only the link reset at exit is reset,
+  // and only by the fast exit
+  static int exit_resets = 0;
+  static int other_resets = 0;
+  ExitingChain::Link* exit_link = new ExitingChain::Link(
+      10, [] { return true; },
+      [] {
+        exit_resets++;
+        return true;
+      });
+  exit_link->SetResetAtExit(true);
+  ExitingChain::Link* other_link = new ExitingChain::Link(
+      20, [] { return true; },
+      [] {
+        other_resets++;
+        return true;
+      });
+
+  ExitingRunner exiting_runner;
+  res = exiting_runner.Run();
+  assert(res);
+  res = exiting_runner.Reset();
+  assert(res);
+  assert(exit_resets == 0);
+  res = exiting_runner.FastExit();
+  assert(res);
+  assert(exit_resets == 1);
+  assert(other_resets == 0);
+
+  // Lock-free no-ops after the fast exit
+  delete other_link;
+  delete exit_link;
+
+  // Repeated run takes the link mutex once
+  CountedChain::Link counted_link(10, [] { return true; },
+                                  [] { return true; });
+  CountedRunner counted_runner;
+  res = counted_runner.Run();
+  assert(res);
+  int locks = CountingMutex::locks;
+  res = counted_runner.Run();
+  assert(res);
+  assert(CountingMutex::locks == locks + 1);
+  (void)locks;
+
   return 0;
 }
@@ -0,0 +1,164 @@
+// Copyright (C) 2020  Aleksey Romanov (aleksey at voltanet dot io)
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+// Offline startup analyzer
+//
+// Reads a startup profile (see init_chain_analyzer.h) and prints
+// the critical path, makespans for 1..N threads, idle time per
+// level and the links to optimize first.
+//
+#include <getopt.h>
+#include <init_chain_analyzer.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static void Usage() {
+  std::cout << "usage: init_chain_analyze [option] profile\n";
+  std::cout << "where option could be:\n";
+  std::cout << "    -d, --dot file          write graph in DOT format\n";
+  std::cout << "    -h, --help              print this message\n";
+  std::cout << "    -j, --json file         write graph in JSON format\n";
+  std::cout << "    -n, --no-level-barriers ignore levels, use only"
+               " declared dependencies\n";
+  std::cout << "    -t, --threads count     max number of threads,"
+               " default 8\n";
+  std::cout << "    -T, --top count         number of links to optimize,"
+               " default 5\n";
+}
+
+int main(int argc, char** argv) {
+  std::string dot_file;
+  std::string json_file;
+  bool level_barriers = true;
+  size_t threads = 8;
+  size_t top = 5;
+
+  static struct option long_options[] = {
+      {"dot", required_argument, 0, 'd'},
+      {"help", no_argument, 0, 'h'},
+      {"json", required_argument, 0, 'j'},
+      {"no-level-barriers", no_argument, 0, 'n'},
+      {"threads", required_argument, 0, 't'},
+      {"top", required_argument, 0, 'T'},
+      {0, 0, 0, 0}};
+
+  for (;;) {
+    int c = getopt_long(argc, argv, "d:hj:nt:T:", long_options, 0);
+    if (c == -1) {
+      break;
+    }
+
+    switch (c) {
+      case 'd':
+        dot_file = optarg;
+        break;
+      case 'j':
+        json_file = optarg;
+        break;
+      case 'n':
+        level_barriers = false;
+        break;
+      case 't':
+        threads = std::strtoul(optarg, nullptr, 0);
+        break;
+      case 'T':
+        top = std::strtoul(optarg, nullptr, 0);
+        break;
+      case 'h':
+      default:
+        Usage();
+        return 1;
+    }
+  }
+
+  if (optind + 1 != argc || threads == 0) {
+    Usage();
+    return 1;
+  }
+
+  std::ifstream in(argv[optind]);
+  if (!in) {
+    std::cerr << "cannot open " << argv[optind] << "\n";
+    return 1;
+  }
+
+  simple::StartupAnalyzer analyzer;
+  analyzer.SetLevelBarriers(level_barriers);
+
+  std::string error;
+  if (!analyzer.Load(in, &error) || !analyzer.Analyze(&error)) {
+    std::cerr << argv[optind] << ": " << error << "\n";
+    return 1;
+  }
+
+  double total = analyzer.GetTotal();
+  std::cout << "total:         " << total << "\n";
+  std::cout << "critical path: " << analyzer.GetCriticalPathLength() << "\n";
+  for (auto const& name : analyzer.GetCriticalPath()) {
+    std::cout << "    " << name << "\n";
+  }
+
+  std::cout << "\n" << std::setw(8) << "threads" << std::setw(14)
+            << "makespan" << std::setw(14) << "bound" << std::setw(10)
+            << "speedup\n";
+  for (size_t count = 1; count <= threads; count *= 2) {
+    double makespan = analyzer.GetMakespan(count);
+    std::cout << std::setw(8) << count << std::setw(14) << makespan
+              << std::setw(14) << analyzer.GetMakespanBound(count)
+              << std::setw(10) << std::fixed << std::setprecision(2)
+              << (makespan > 0 ? total / makespan : 0) << "\n";
+    std::cout.unsetf(std::ios::fixed);
+    std::cout << std::setprecision(6);
+  }
+
+  std::cout << "\nidle per level, " << threads << " threads\n";
+  std::cout << std::setw(8) << "level" << std::setw(14) << "start"
+            << std::setw(14) << "finish" << std::setw(14) << "busy"
+            << std::setw(14) << "idle\n";
+  for (auto const& gap : analyzer.GetLevelGaps(threads)) {
+    std::cout << std::setw(8) << gap.level << std::setw(14) << gap.start
+              << std::setw(14) << gap.finish << std::setw(14) << gap.busy
+              << std::setw(14) << gap.idle << "\n";
+  }
+
+  std::cout << "\nlinks to optimize\n";
+  for (auto const& name : analyzer.GetTopLinks(top)) {
+    std::cout << "    " << name << "\n";
+  }
+
+  if (!dot_file.empty()) {
+    std::ofstream out(dot_file);
+    analyzer.WriteDot(out);
+  }
+
+  if (!json_file.empty()) {
+    std::ofstream out(json_file);
+    analyzer.WriteJson(out);
+  }
+
+  return 0;
+}